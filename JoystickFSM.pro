@@ -16,27 +16,62 @@ INCLUDEPATH += ../../inc/bdaqctrl.h
 # Sources
 SOURCES += src/main.cpp\
            src/mainwindow.cpp\
+           src/ao_stream.cpp\
+           src/ao_transform.cpp\
+           src/buffered_ao_device.cpp\
+           src/control_thread.cpp\
+           src/evdev_joystick.cpp\
+           src/filter_pipeline.cpp\
+           src/input_reactor.cpp\
            src/joystick.cpp\
            src/joystick_factory.cpp\
            src/configuredialog.cpp\
            src/libinput_joystick.cpp\
+           src/simulated_ao_device.cpp\
+           src/utils/benchmark.cpp\
            src/utils/evdev_helper.cpp\
+           src/utils/event_clock.cpp\
+           src/utils/input_device_index.cpp\
+           src/utils/io_uring.cpp\
+           src/utils/latency_histogram.cpp\
            src/utils/libinput_helper.cpp\
+           src/utils/report_meter.cpp\
            src/widgets/axis_widget.cpp\
            src/widgets/button_widget.cpp\
+           src/widgets/rudder_widget.cpp\
+           src/widgets/throttle_widget.cpp\
            src/widgets/simplegraph.cpp
 
 HEADERS += src/mainwindow.h\
+           src/ao_stream.h\
+           src/ao_transform.h\
+           src/buffered_ao_device.h\
+           src/control_thread.h\
+           src/evdev_joystick.h\
+           src/filter_pipeline.h\
+           src/input_reactor.h\
            src/joystick.h\
            src/joystick_factory.h\
            src/joystick_description.h\
+           src/joystick_state.h\
            src/configuredialog.h\
            src/libinput_joystick.h\
+           src/simulated_ao_device.h\
+           src/utils/benchmark.h\
            src/utils/evdev_helper.h\
+           src/utils/event_clock.h\
+           src/utils/input_device_index.h\
+           src/utils/io_uring.h\
+           src/utils/latency_histogram.h\
            src/utils/libinput_helper.h\
+           src/utils/report_meter.h\
            src/utils/dialog_helper.h\
+           src/utils/seqlock.h\
+           src/utils/spsc_ring.h\
            src/widgets/axis_widget.h\
            src/widgets/button_widget.h\
+           src/widgets/rudder_widget.h\
+           src/widgets/throttle_widget.h\
            src/widgets/simplegraph.h\
            src/widgets/waveformgenerator.h\
 
@@ -0,0 +1,228 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ao_stream.h"
+
+#include <QDebug>
+#include <algorithm>
+
+// Timing error, in chunks, after which the waveform timeline is restarted
+static const int ResyncChunks = 4;
+
+// Share of the excess timing error corrected on each refill
+static const int DriftCorrectionDivisor = 8;
+
+AoStream::AoStream(std::unique_ptr<BufferedAoDevice> device)
+    : m_device(std::move(device)),
+      m_interpolation(Linear),
+      m_channelCount(0),
+      m_rate(0),
+      m_chunkSamples(0),
+      m_lag(0),
+      m_running(false),
+      m_historyCapacity(0),
+      m_historyHead(0),
+      m_historyCount(0),
+      m_renderStart(0),
+      m_samplesRendered(0),
+      m_resyncs(0)
+{
+}
+
+AoStream::~AoStream()
+{
+    stop();
+}
+
+ErrorCode AoStream::configure(const AoTransform& transform, int rate, int chunkSamples,
+                              Interpolation interpolation, int controlRate)
+{
+    m_transform = transform;
+    m_interpolation = interpolation;
+    m_channelCount = transform.getChannelCount();
+    m_rate = std::max(MinRate, std::min(MaxRate, rate));
+
+    // A chunk must span at least two ticks, or the loop cannot refill it in time
+    int64_t controlPeriod = 1000000000LL / controlRate;
+    int minChunk = static_cast<int>(2 * controlPeriod * m_rate / 1000000000LL) + 1;
+    if (chunkSamples < minChunk) {
+        qWarning() << "AO stream chunk raised to" << minChunk << "samples to cover two control ticks";
+        chunkSamples = minChunk;
+    }
+    m_chunkSamples = chunkSamples;
+
+    // A chunk is rendered up to one chunk before it plays; on top the
+    // interpolation needs the commands on both sides of every sample, and
+    // one more tick covers a late wakeup of the loop
+    int64_t chunkPeriod = static_cast<int64_t>(m_chunkSamples) * 1000000000LL / m_rate;
+    m_lag = chunkPeriod + (interpolation == Cubic ? 3 : 2) * controlPeriod;
+
+    // Keep every command the next chunk can reach back to, plus spares for jitter
+    m_historyCapacity = static_cast<int>((m_lag + chunkPeriod) / controlPeriod) + 8;
+    m_commandTimes.assign(m_historyCapacity, 0);
+    m_commandVolts.assign(static_cast<size_t>(m_historyCapacity) * m_channelCount, 0.0);
+    m_chunk.assign(static_cast<size_t>(m_chunkSamples) * m_channelCount, 0.0);
+    m_historyHead = 0;
+    m_historyCount = 0;
+
+    return m_device->prepare(transform.getChannelStart(), m_channelCount, m_rate, m_chunkSamples);
+}
+
+ErrorCode AoStream::start(int64_t now, const double* volts)
+{
+    if (m_channelCount == 0) {
+        return ErrorFuncBusy;
+    }
+
+    m_historyHead = 0;
+    m_historyCount = 0;
+    m_resyncs = 0;
+    pushCommand(now, volts);
+
+    // The first refill comes once the first chunk has played, one chunk later
+    resync(now);
+    m_renderStart -= static_cast<int64_t>(m_chunkSamples) * 1000000000LL / m_rate;
+
+    // Both chunks before the device starts
+    for (int i = 0; i < 2; i++) {
+        ErrorCode errorCode = renderChunk();
+        if (BioFailed(errorCode)) {
+            return errorCode;
+        }
+    }
+
+    ErrorCode errorCode = m_device->start();
+    m_running = !BioFailed(errorCode);
+    return errorCode;
+}
+
+void AoStream::stop()
+{
+    if (m_running) {
+        m_device->stop();
+        m_running = false;
+    }
+}
+
+void AoStream::pushCommand(int64_t time, const double* volts)
+{
+    m_commandTimes[m_historyHead] = time;
+    std::copy(volts, volts + m_channelCount, &m_commandVolts[static_cast<size_t>(m_historyHead) * m_channelCount]);
+
+    m_historyHead = (m_historyHead + 1) % m_historyCapacity;
+    if (m_historyCount < m_historyCapacity) {
+        m_historyCount++;
+    }
+}
+
+ErrorCode AoStream::refill(int64_t now)
+{
+    if (!m_running || m_device->freeChunks() == 0) {
+        return Success;
+    }
+
+    // The waveform is paced by the samples the device consumes. Its clock
+    // and CLOCK_MONOTONIC drift apart slowly: errors beyond a chunk of
+    // scheduling jitter are pulled in gradually so the output stays
+    // continuous, and only a gross error (an underrun) restarts the timeline
+    int64_t chunkPeriod = static_cast<int64_t>(m_chunkSamples) * 1000000000LL / m_rate;
+    int64_t renderTime = m_renderStart + static_cast<int64_t>(m_samplesRendered * 1e9 / m_rate);
+    int64_t error = renderTime - (now - m_lag);
+    if (error > ResyncChunks * chunkPeriod || error < -ResyncChunks * chunkPeriod) {
+        resync(now);
+        m_resyncs++;
+    } else if (error > chunkPeriod) {
+        m_renderStart -= (error - chunkPeriod) / DriftCorrectionDivisor;
+    } else if (error < -chunkPeriod) {
+        m_renderStart -= (error + chunkPeriod) / DriftCorrectionDivisor;
+    }
+
+    while (m_device->freeChunks() > 0) {
+        ErrorCode errorCode = renderChunk();
+        if (BioFailed(errorCode)) {
+            return errorCode;
+        }
+    }
+
+    return Success;
+}
+
+void AoStream::resync(int64_t now)
+{
+    // Render the waveform so its newest sample still lies behind the newest command
+    m_renderStart = now - m_lag;
+    m_samplesRendered = 0;
+}
+
+ErrorCode AoStream::renderChunk()
+{
+    const int oldest = (m_historyHead - m_historyCount + m_historyCapacity) % m_historyCapacity;
+    const double sampleNs = 1e9 / m_rate;
+
+    // Commands are walked once per chunk, samples only move forward in time
+    int segment = 0;
+    for (int i = 0; i < m_chunkSamples; i++) {
+        double t = static_cast<double>(m_renderStart) + (m_samplesRendered + i) * sampleNs;
+
+        while (segment + 1 < m_historyCount &&
+               m_commandTimes[(oldest + segment + 1) % m_historyCapacity] <= t) {
+            segment++;
+        }
+
+        int i1 = (oldest + segment) % m_historyCapacity;
+        double* out = &m_chunk[static_cast<size_t>(i) * m_channelCount];
+        const double* p1 = &m_commandVolts[static_cast<size_t>(i1) * m_channelCount];
+
+        // Before the first or after the last command the output holds
+        if (segment + 1 >= m_historyCount || t < m_commandTimes[i1]) {
+            std::copy(p1, p1 + m_channelCount, out);
+            continue;
+        }
+
+        int i2 = (i1 + 1) % m_historyCapacity;
+        const double* p2 = &m_commandVolts[static_cast<size_t>(i2) * m_channelCount];
+        double u = (t - m_commandTimes[i1]) / static_cast<double>(m_commandTimes[i2] - m_commandTimes[i1]);
+
+        if (m_interpolation == Linear) {
+            for (int ch = 0; ch < m_channelCount; ch++) {
+                out[ch] = p1[ch] + (p2[ch] - p1[ch]) * u;
+            }
+            continue;
+        }
+
+        // Catmull-Rom, repeating the end points where neighbours are missing
+        int i0 = segment > 0 ? (i1 - 1 + m_historyCapacity) % m_historyCapacity : i1;
+        int i3 = segment + 2 < m_historyCount ? (i2 + 1) % m_historyCapacity : i2;
+        const double* p0 = &m_commandVolts[static_cast<size_t>(i0) * m_channelCount];
+        const double* p3 = &m_commandVolts[static_cast<size_t>(i3) * m_channelCount];
+        double u2 = u * u;
+        double u3 = u2 * u;
+
+        for (int ch = 0; ch < m_channelCount; ch++) {
+            double v = 0.5 * (2.0 * p1[ch] + (p2[ch] - p0[ch]) * u
+                              + (2.0 * p0[ch] - 5.0 * p1[ch] + 4.0 * p2[ch] - p3[ch]) * u2
+                              + (3.0 * p1[ch] - p0[ch] - 3.0 * p2[ch] + p3[ch]) * u3);
+
+            // The spline may overshoot between commands
+            const AoChannelTransform& limits = m_transform.channel(m_transform.getChannelStart() + ch);
+            out[ch] = std::max(limits.minVolts, std::min(limits.maxVolts, v));
+        }
+    }
+
+    m_samplesRendered += m_chunkSamples;
+    return m_device->writeChunk(m_chunk.data());
+}
@@ -0,0 +1,119 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AO_STREAM_H
+#define AO_STREAM_H
+
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include "ao_transform.h"
+#include "buffered_ao_device.h"
+
+/**
+ * Hardware-paced AO output that interpolates between control commands
+ *
+ * The control loop pushes one command per tick and calls refill(); every
+ * chunk the device has finished playing is rendered again from the command
+ * history. The waveform follows the commands a fixed lag behind real time,
+ * long enough that every rendered sample lies between known commands, so
+ * the output is a smooth line or curve instead of a staircase.
+ */
+class AoStream
+{
+public:
+    enum Interpolation {
+        Linear,     // Straight lines between commands
+        Cubic       // Catmull-Rom spline through the commands, one tick more lag
+    };
+
+    static const int MinRate = 10000;
+    static const int MaxRate = 100000;
+
+    /**
+     * @param device Output device, owned by the stream
+     */
+    explicit AoStream(std::unique_ptr<BufferedAoDevice> device);
+    ~AoStream();
+
+    /**
+     * Size the buffers and prepare the device (not real-time safe)
+     * @param transform Channels written and their voltage limits
+     * @param rate Sample rate per channel in Hz
+     * @param chunkSamples Samples per channel refilled at a time
+     * @param interpolation Interpolation between commands
+     * @param controlRate Rate at which commands are pushed in Hz
+     */
+    ErrorCode configure(const AoTransform& transform, int rate, int chunkSamples,
+                        Interpolation interpolation, int controlRate);
+
+    /**
+     * Fill both chunks with a constant output and start the device
+     * @param now CLOCK_MONOTONIC time in nanoseconds
+     * @param volts Initial value of every channel
+     */
+    ErrorCode start(int64_t now, const double* volts);
+
+    void stop();
+
+    /**
+     * Add the command of one control tick
+     * @param time CLOCK_MONOTONIC time of the command in nanoseconds
+     * @param volts Value of every channel
+     */
+    void pushCommand(int64_t time, const double* volts);
+
+    /**
+     * Render and write every chunk the device has released
+     * @param now CLOCK_MONOTONIC time in nanoseconds
+     */
+    ErrorCode refill(int64_t now);
+
+    int getRate() const { return m_rate; }
+    int getChunkSamples() const { return m_chunkSamples; }
+    int64_t getLag() const { return m_lag; }
+    uint64_t underruns() const { return m_device->underruns(); }
+    uint64_t resyncs() const { return m_resyncs; }
+
+private:
+    ErrorCode renderChunk();
+    void resync(int64_t now);
+
+    std::unique_ptr<BufferedAoDevice> m_device;
+    AoTransform m_transform;
+    Interpolation m_interpolation;
+    int m_channelCount;
+    int m_rate;
+    int m_chunkSamples;
+    int64_t m_lag;                  // How far the waveform trails real time, in nanoseconds
+    bool m_running;
+
+    // Command history, oldest first in ring order
+    std::vector<int64_t> m_commandTimes;
+    std::vector<double> m_commandVolts;     // m_channelCount values per command
+    int m_historyCapacity;
+    int m_historyHead;              // Slot of the next command
+    int m_historyCount;
+
+    std::vector<double> m_chunk;    // Interleaved samples of one chunk
+    int64_t m_renderStart;          // Waveform time of sample zero in nanoseconds
+    uint64_t m_samplesRendered;     // Samples per channel rendered since start
+    uint64_t m_resyncs;
+};
+
+#endif // AO_STREAM_H
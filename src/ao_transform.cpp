@@ -0,0 +1,117 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ao_transform.h"
+
+#include <QDebug>
+
+AoTransform::AoTransform()
+    : m_channelStart(0),
+      m_channelCount(0)
+{
+}
+
+bool AoTransform::rangeLimits(ValueRange range, double& minVolts, double& maxVolts)
+{
+    // Ask the driver first, it knows every range the hardware supports
+    MathInterval interval;
+    ValueUnit unit;
+    if (!BioFailed(AdxGetValueRangeInformation(range, 0, nullptr, &interval, &unit)) &&
+        interval.Max > interval.Min) {
+        if (unit == Volt) {
+            minVolts = interval.Min;
+            maxVolts = interval.Max;
+            return true;
+        }
+        if (unit == Millivolt) {
+            minVolts = interval.Min / 1000.0;
+            maxVolts = interval.Max / 1000.0;
+            return true;
+        }
+    }
+
+    switch (range) {
+        case V_Neg10To10:
+            minVolts = -10.0;
+            maxVolts = 10.0;
+            return true;
+        case V_Neg5To5:
+            minVolts = -5.0;
+            maxVolts = 5.0;
+            return true;
+        case V_0To10:
+            minVolts = 0.0;
+            maxVolts = 10.0;
+            return true;
+        case V_0To5:
+            minVolts = 0.0;
+            maxVolts = 5.0;
+            return true;
+        default:
+            minVolts = -10.0;
+            maxVolts = 10.0;
+            return false;
+    }
+}
+
+void AoTransform::setChannelCount(int channelStart, int channelCount)
+{
+    if (channelCount > MaxChannels) {
+        qWarning() << "Only the first" << MaxChannels << "AO channels are driven";
+        channelCount = MaxChannels;
+    }
+
+    m_channelStart = channelStart;
+    m_channelCount = channelCount < 0 ? 0 : channelCount;
+}
+
+void AoTransform::setChannelRange(int index, ValueRange range)
+{
+    double minVolts = 0.0;
+    double maxVolts = 0.0;
+    if (!rangeLimits(range, minVolts, maxVolts)) {
+        qWarning() << "AO channel" << m_channelStart + index << "has no voltage range, assuming +/-10 V";
+    }
+
+    // Zero maps to the middle of the range, full scale to either end
+    AoChannelTransform& transform = m_channels[index];
+    transform.offset = (maxVolts + minVolts) / 2.0;
+    transform.scale = (maxVolts - minVolts) / 2.0;
+    transform.minVolts = minVolts;
+    transform.maxVolts = maxVolts;
+}
+
+void AoTransform::configure(InstantAoCtrl* ctrl, int channelStart, int channelCount)
+{
+    setChannelCount(channelStart, channelCount);
+
+    Array<ValueRange>* valueRanges = ctrl->getChannelRanges();
+    for (int i = 0; i < m_channelCount; i++) {
+        int physical = channelStart + i;
+        setChannelRange(i, physical < valueRanges->getCount() ? valueRanges->getItem(physical)
+                                                              : valueRanges->getItem(0));
+    }
+}
+
+void AoTransform::configure(ValueRange range, int channelStart, int channelCount)
+{
+    setChannelCount(channelStart, channelCount);
+
+    for (int i = 0; i < m_channelCount; i++) {
+        setChannelRange(i, range);
+    }
+}
@@ -0,0 +1,106 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef AO_TRANSFORM_H
+#define AO_TRANSFORM_H
+
+// Advantech DAQ headers
+#include "../../inc/bdaqctrl.h"
+using namespace Automation::BDaq;
+
+/**
+ * Affine map from a normalized command (-1.0 to 1.0) to volts on one channel
+ */
+struct AoChannelTransform {
+    double scale;       // Volts per normalized unit
+    double offset;      // Volts at a normalized command of zero
+    double minVolts;    // Lower limit of the channel range
+    double maxVolts;    // Upper limit of the channel range
+
+    double apply(double x) const
+    {
+        double volts = x * scale + offset;
+        if (volts < minVolts) volts = minVolts;
+        if (volts > maxVolts) volts = maxVolts;
+        return volts;
+    }
+};
+
+/**
+ * Per-channel voltage transforms of an AO device
+ *
+ * Built once from the configured channel ranges so the control loop only
+ * does a multiply-add and a clamp per channel, with each channel using its
+ * own range.
+ */
+class AoTransform
+{
+public:
+    static const int MaxChannels = 32;
+
+    AoTransform();
+
+    /**
+     * Read the ranges of the written channels from the device
+     * @param ctrl Configured instant AO control
+     * @param channelStart First physical channel written
+     * @param channelCount Number of channels written
+     */
+    void configure(InstantAoCtrl* ctrl, int channelStart, int channelCount);
+
+    /**
+     * Use the same range on every written channel, for outputs without an
+     * instant AO control
+     * @param range Value range of all channels
+     * @param channelStart First physical channel written
+     * @param channelCount Number of channels written
+     */
+    void configure(ValueRange range, int channelStart, int channelCount);
+
+    int getChannelStart() const { return m_channelStart; }
+    int getChannelCount() const { return m_channelCount; }
+
+    bool contains(int channel) const
+    {
+        return channel >= m_channelStart && channel < m_channelStart + m_channelCount;
+    }
+
+    /**
+     * Get the transform of a written channel
+     * @param channel Physical channel, must satisfy contains()
+     */
+    const AoChannelTransform& channel(int channel) const { return m_channels[channel - m_channelStart]; }
+
+    /**
+     * Get the voltage limits of a value range
+     * @param range BDaq value range
+     * @param minVolts Receives the lower limit
+     * @param maxVolts Receives the upper limit
+     * @return False if the range is not a voltage range (±10 V is assumed)
+     */
+    static bool rangeLimits(ValueRange range, double& minVolts, double& maxVolts);
+
+private:
+    void setChannelCount(int channelStart, int channelCount);
+    void setChannelRange(int index, ValueRange range);
+
+    AoChannelTransform m_channels[MaxChannels];
+    int m_channelStart;
+    int m_channelCount;
+};
+
+#endif // AO_TRANSFORM_H
@@ -0,0 +1,144 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "buffered_ao_device.h"
+
+#include <QDebug>
+
+BufferedAoDevice::BufferedAoDevice()
+    : m_freeChunks(0),
+      m_underruns(0)
+{
+}
+
+BdaqBufferedAoDevice::BdaqBufferedAoDevice(const std::wstring& deviceName,
+                                           const std::wstring& profilePath,
+                                           ValueRange valueRange)
+    : m_ctrl(nullptr),
+      m_deviceName(deviceName),
+      m_profilePath(profilePath),
+      m_valueRange(valueRange),
+      m_chunkLength(0),
+      m_running(false)
+{
+}
+
+BdaqBufferedAoDevice::~BdaqBufferedAoDevice()
+{
+    stop();
+
+    if (m_ctrl) {
+        m_ctrl->Dispose();
+        m_ctrl = nullptr;
+    }
+}
+
+ErrorCode BdaqBufferedAoDevice::prepare(int channelStart, int channelCount, int rate, int chunkSamples)
+{
+    ErrorCode errorCode = Success;
+
+    if (m_ctrl == nullptr) {
+        m_ctrl = BufferedAoCtrl::Create();
+        m_ctrl->addDataTransmittedHandler(OnDataTransmittedEvent, this);
+        m_ctrl->addUnderrunHandler(OnUnderrunEvent, this);
+    }
+
+    DeviceInformation devInfo(m_deviceName.c_str());
+    errorCode = m_ctrl->setSelectedDevice(devInfo);
+    if (BioFailed(errorCode)) {
+        return errorCode;
+    }
+
+    if (!m_profilePath.empty()) {
+        errorCode = m_ctrl->LoadProfile(m_profilePath.c_str());
+        if (BioFailed(errorCode)) {
+            return errorCode;
+        }
+    }
+
+    // Two chunks in the buffer, an event after each one is played
+    ScanChannel* scanChannel = m_ctrl->getScanChannel();
+    scanChannel->setChannelStart(channelStart);
+    scanChannel->setChannelCount(channelCount);
+    scanChannel->setSamples(chunkSamples * 2);
+    scanChannel->setIntervalCount(chunkSamples);
+
+    Array<ValueRange>* valueRanges = m_ctrl->getChannelRanges();
+    for (int i = channelStart; i < channelStart + channelCount && i < valueRanges->getCount(); i++) {
+        valueRanges->setItem(i, m_valueRange);
+    }
+
+    m_ctrl->getConvertClock()->setRate(rate);
+
+    errorCode = m_ctrl->setStreaming(true);
+    if (BioFailed(errorCode)) {
+        return errorCode;
+    }
+
+    errorCode = m_ctrl->Prepare();
+    if (BioFailed(errorCode)) {
+        return errorCode;
+    }
+
+    m_chunkLength = chunkSamples * channelCount;
+    resetChunks(2);
+    return Success;
+}
+
+ErrorCode BdaqBufferedAoDevice::start()
+{
+    ErrorCode errorCode = m_ctrl ? m_ctrl->Start() : ErrorDeviceNotExist;
+    m_running = !BioFailed(errorCode);
+    return errorCode;
+}
+
+void BdaqBufferedAoDevice::stop()
+{
+    if (m_ctrl && m_running) {
+        // Finish immediately rather than after the buffered data
+        m_ctrl->Stop(1);
+        m_ctrl->Release();
+        m_running = false;
+    }
+}
+
+ErrorCode BdaqBufferedAoDevice::writeChunk(const double* data)
+{
+    // SetData queues the samples behind those not yet played
+    ErrorCode errorCode = m_ctrl->SetData(m_chunkLength, const_cast<double*>(data));
+    if (!BioFailed(errorCode)) {
+        chunkWritten();
+    }
+    return errorCode;
+}
+
+void BDAQCALL BdaqBufferedAoDevice::OnDataTransmittedEvent(void *sender, BfdAoEventArgs *args, void *userParam)
+{
+    Q_UNUSED(sender);
+    Q_UNUSED(args);
+
+    // Called from the driver thread, the control loop picks the chunk up
+    static_cast<BdaqBufferedAoDevice*>(userParam)->chunkTransmitted();
+}
+
+void BDAQCALL BdaqBufferedAoDevice::OnUnderrunEvent(void *sender, BfdAoEventArgs *args, void *userParam)
+{
+    Q_UNUSED(sender);
+    Q_UNUSED(args);
+
+    static_cast<BdaqBufferedAoDevice*>(userParam)->underrun();
+}
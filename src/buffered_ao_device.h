@@ -0,0 +1,119 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BUFFERED_AO_DEVICE_H
+#define BUFFERED_AO_DEVICE_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+
+// Advantech DAQ headers
+#include "../../inc/bdaqctrl.h"
+using namespace Automation::BDaq;
+
+/**
+ * Hardware-clocked AO output with a buffer split into two chunks
+ *
+ * While the device plays one chunk the other is refilled. The device
+ * reports each chunk it has finished playing; writeChunk() fills the
+ * oldest free one. Implemented by the BDaq buffered AO control and by a
+ * simulated device for running without hardware.
+ */
+class BufferedAoDevice
+{
+public:
+    BufferedAoDevice();
+    virtual ~BufferedAoDevice() {}
+
+    /**
+     * Set up the device; afterwards both chunks are free
+     * @param channelStart First physical channel
+     * @param channelCount Number of channels, samples are interleaved
+     * @param rate Sample rate per channel in Hz
+     * @param chunkSamples Samples per channel in one chunk
+     */
+    virtual ErrorCode prepare(int channelStart, int channelCount, int rate, int chunkSamples) = 0;
+
+    /**
+     * Start playing; both chunks must have been written
+     */
+    virtual ErrorCode start() = 0;
+
+    /**
+     * Stop playing and release the buffer
+     */
+    virtual void stop() = 0;
+
+    /**
+     * Fill the oldest free chunk
+     * @param data chunkSamples * channelCount interleaved samples in volts
+     */
+    virtual ErrorCode writeChunk(const double* data) = 0;
+
+    // Chunks played and not yet refilled
+    int freeChunks() const { return m_freeChunks.load(std::memory_order_acquire); }
+
+    // Times the device ran out of data
+    uint64_t underruns() const { return m_underruns.load(std::memory_order_relaxed); }
+
+protected:
+    // Called by implementations, from any thread
+    void chunkTransmitted() { m_freeChunks.fetch_add(1, std::memory_order_release); }
+    void chunkWritten() { m_freeChunks.fetch_sub(1, std::memory_order_acq_rel); }
+    void resetChunks(int free) { m_freeChunks.store(free, std::memory_order_release); }
+    void underrun() { m_underruns.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    std::atomic<int> m_freeChunks;
+    std::atomic<uint64_t> m_underruns;
+};
+
+/**
+ * Buffered AO streaming on an Advantech device
+ */
+class BdaqBufferedAoDevice : public BufferedAoDevice
+{
+public:
+    /**
+     * @param deviceName Device description as shown by DAQNavi
+     * @param profilePath Optional device profile
+     * @param valueRange Range applied to every streamed channel
+     */
+    BdaqBufferedAoDevice(const std::wstring& deviceName, const std::wstring& profilePath,
+                         ValueRange valueRange);
+    ~BdaqBufferedAoDevice() override;
+
+    ErrorCode prepare(int channelStart, int channelCount, int rate, int chunkSamples) override;
+    ErrorCode start() override;
+    void stop() override;
+    ErrorCode writeChunk(const double* data) override;
+
+private:
+    // Static callbacks for Advantech AO events
+    static void BDAQCALL OnDataTransmittedEvent(void *sender, BfdAoEventArgs *args, void *userParam);
+    static void BDAQCALL OnUnderrunEvent(void *sender, BfdAoEventArgs *args, void *userParam);
+
+    BufferedAoCtrl* m_ctrl;
+    std::wstring m_deviceName;
+    std::wstring m_profilePath;
+    ValueRange m_valueRange;
+    int m_chunkLength;          // Samples over all channels in one chunk
+    bool m_running;
+};
+
+#endif // BUFFERED_AO_DEVICE_H
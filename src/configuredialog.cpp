@@ -40,6 +40,9 @@ ConfigureDialog::ConfigureDialog(QDialog *parent)
     connect(ui->chkInvertY, &QCheckBox::toggled, 
             this, &ConfigureDialog::InvertYChanged);
 
+    connect(ui->cmbOutputEngine, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &ConfigureDialog::OutputEngineChanged);
+
     // Set the maximum value of clock rate per channel 500MHz
     ui->edtClockRatePerChan->setValidator(new QDoubleValidator(1, MAXCLOCKRATE, 2, this));
 
@@ -119,6 +122,19 @@ void ConfigureDialog::Initialization()
         }
     }
 
+    // Set initial control loop values
+    ui->spinMaxRate->setValue(configure.controlRate);
+    ui->chkRealtime->setChecked(configure.realtimeControl);
+    ui->cmbOutputMode->setCurrentText(configure.outputMode);
+    ui->spinMinWriteInterval->setValue(configure.minWriteInterval);
+    ui->spinInputCpu->setValue(configure.inputCpu);
+    ui->cmbInputBackend->setCurrentText(configure.inputBackend);
+    ui->cmbOutputEngine->setCurrentText(configure.aoOutputEngine);
+    OutputEngineChanged(ui->cmbOutputEngine->currentIndex());
+    ui->spinStreamRate->setValue(configure.streamRate);
+    ui->cmbInterpolation->setCurrentText(configure.streamInterpolation);
+    ui->spinRefillInterval->setValue(configure.streamRefillInterval);
+
     // Set initial joystick configuration values
     ui->cmbJoystickBackend->setCurrentText(configure.joystickBackend);
     ui->spinDeadzone->setValue(configure.deadzone);
@@ -127,6 +143,32 @@ void ConfigureDialog::Initialization()
     ui->chkInvertX->setChecked(configure.invertX);
     ui->chkInvertY->setChecked(configure.invertY);
 
+    // Set initial filter values
+    ui->spinXDeadzone->setValue(configure.xFilter.deadzone);
+    ui->spinYDeadzone->setValue(configure.yFilter.deadzone);
+    ui->spinXExpo->setValue(configure.xFilter.expo);
+    ui->spinYExpo->setValue(configure.yFilter.expo);
+    ui->spinXSmoothingCutoff->setValue(configure.xFilter.smoothingCutoff);
+    ui->spinYSmoothingCutoff->setValue(configure.yFilter.smoothingCutoff);
+    ui->spinXSmoothingBeta->setValue(configure.xFilter.smoothingBeta);
+    ui->spinYSmoothingBeta->setValue(configure.yFilter.smoothingBeta);
+    ui->spinXSmoothingDCutoff->setValue(configure.xFilter.smoothingDCutoff);
+    ui->spinYSmoothingDCutoff->setValue(configure.yFilter.smoothingDCutoff);
+    ui->spinXLowpassCutoff->setValue(configure.xFilter.lowpassCutoff);
+    ui->spinYLowpassCutoff->setValue(configure.yFilter.lowpassCutoff);
+    ui->spinXLowpassQ->setValue(configure.xFilter.lowpassQ);
+    ui->spinYLowpassQ->setValue(configure.yFilter.lowpassQ);
+    ui->spinXSlewRate->setValue(configure.xFilter.slewRate);
+    ui->spinYSlewRate->setValue(configure.yFilter.slewRate);
+    ui->cmbXPrediction->setCurrentIndex(configure.xFilter.predictionMode);
+    ui->cmbYPrediction->setCurrentIndex(configure.yFilter.predictionMode);
+    ui->spinXPredictionHorizon->setValue(configure.xFilter.predictionHorizon * 1000.0);
+    ui->spinYPredictionHorizon->setValue(configure.yFilter.predictionHorizon * 1000.0);
+    ui->spinXPredictionAlpha->setValue(configure.xFilter.predictionAlpha);
+    ui->spinYPredictionAlpha->setValue(configure.yFilter.predictionAlpha);
+    ui->spinXPredictionBeta->setValue(configure.xFilter.predictionBeta);
+    ui->spinYPredictionBeta->setValue(configure.yFilter.predictionBeta);
+
     // Clean up temporary objects
     waveformAiCtrl->Dispose();
     supportedAiDevices->Dispose();
@@ -135,6 +177,20 @@ void ConfigureDialog::Initialization()
 }
 
 // New Joystick-specific slot implementations
+void ConfigureDialog::OutputEngineChanged(int index)
+{
+    Q_UNUSED(index);
+
+    // A stream plays commands on its own clock, one per control tick, so
+    // writing on every input frame only applies to instant writes
+    bool instant = ui->cmbOutputEngine->currentText() == "Instant";
+    if (!instant) {
+        ui->cmbOutputMode->setCurrentText("Periodic");
+    }
+    ui->cmbOutputMode->setEnabled(instant);
+    ui->spinMinWriteInterval->setEnabled(instant);
+}
+
 void ConfigureDialog::JoystickBackendChanged(int index)
 {
     configure.joystickBackend = ui->cmbJoystickBackend->currentText();
@@ -170,6 +226,18 @@ void ConfigureDialog::ButtonOKClicked()
 {
     // Existing AI and AO device configuration code remains the same
 
+    // Set control loop configuration
+    configure.controlRate = ui->spinMaxRate->value();
+    configure.realtimeControl = ui->chkRealtime->isChecked();
+    configure.outputMode = ui->cmbOutputMode->currentText();
+    configure.minWriteInterval = ui->spinMinWriteInterval->value();
+    configure.inputCpu = ui->spinInputCpu->value();
+    configure.inputBackend = ui->cmbInputBackend->currentText();
+    configure.aoOutputEngine = ui->cmbOutputEngine->currentText();
+    configure.streamRate = ui->spinStreamRate->value();
+    configure.streamInterpolation = ui->cmbInterpolation->currentText();
+    configure.streamRefillInterval = ui->spinRefillInterval->value();
+
     // Set joystick configuration
     configure.joystickBackend = ui->cmbJoystickBackend->currentText();
     configure.deadzone = ui->spinDeadzone->value();
@@ -178,5 +246,31 @@ void ConfigureDialog::ButtonOKClicked()
     configure.invertX = ui->chkInvertX->isChecked();
     configure.invertY = ui->chkInvertY->isChecked();
 
+    // Set filter configuration
+    configure.xFilter.deadzone = ui->spinXDeadzone->value();
+    configure.yFilter.deadzone = ui->spinYDeadzone->value();
+    configure.xFilter.expo = ui->spinXExpo->value();
+    configure.yFilter.expo = ui->spinYExpo->value();
+    configure.xFilter.smoothingCutoff = ui->spinXSmoothingCutoff->value();
+    configure.yFilter.smoothingCutoff = ui->spinYSmoothingCutoff->value();
+    configure.xFilter.smoothingBeta = ui->spinXSmoothingBeta->value();
+    configure.yFilter.smoothingBeta = ui->spinYSmoothingBeta->value();
+    configure.xFilter.smoothingDCutoff = ui->spinXSmoothingDCutoff->value();
+    configure.yFilter.smoothingDCutoff = ui->spinYSmoothingDCutoff->value();
+    configure.xFilter.lowpassCutoff = ui->spinXLowpassCutoff->value();
+    configure.yFilter.lowpassCutoff = ui->spinYLowpassCutoff->value();
+    configure.xFilter.lowpassQ = ui->spinXLowpassQ->value();
+    configure.yFilter.lowpassQ = ui->spinYLowpassQ->value();
+    configure.xFilter.slewRate = ui->spinXSlewRate->value();
+    configure.yFilter.slewRate = ui->spinYSlewRate->value();
+    configure.xFilter.predictionMode = static_cast<PredictionMode>(ui->cmbXPrediction->currentIndex());
+    configure.yFilter.predictionMode = static_cast<PredictionMode>(ui->cmbYPrediction->currentIndex());
+    configure.xFilter.predictionHorizon = ui->spinXPredictionHorizon->value() / 1000.0;
+    configure.yFilter.predictionHorizon = ui->spinYPredictionHorizon->value() / 1000.0;
+    configure.xFilter.predictionAlpha = ui->spinXPredictionAlpha->value();
+    configure.yFilter.predictionAlpha = ui->spinYPredictionAlpha->value();
+    configure.xFilter.predictionBeta = ui->spinXPredictionBeta->value();
+    configure.yFilter.predictionBeta = ui->spinYPredictionBeta->value();
+
     accept();
 }
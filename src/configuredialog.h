@@ -4,6 +4,7 @@
 #include <QDialog>
 #include <QWidget>
 #include "../../inc/bdaqctrl.h"
+#include "filter_pipeline.h"
 
 using namespace Automation::BDaq;
 
@@ -20,6 +21,8 @@ struct ConfigureParameter
     // AI specific parameters
     int aiChannelStart;
     int aiChannelCount;
+    int aiMirrorXChannel;     // AI channel reading back the mirror X, -1 for none
+    int aiMirrorYChannel;     // AI channel reading back the mirror Y, -1 for none
     ValueRange aiValueRange;
     int32 clockRatePerChan;
     int32 sectionLength;
@@ -30,14 +33,32 @@ struct ConfigureParameter
     ValueRange aoValueRange;
     int pointCountPerWave;
 
+    // Control loop settings
+    int controlRate;          // Control loop rate in Hz (250 - 5000)
+    bool realtimeControl;     // Run the control loop with SCHED_FIFO
+    QString outputMode;       // "Periodic" or "Event-driven"
+    int minWriteInterval;     // Minimum time between AO writes in microseconds
+    int inputCpu;             // CPU the input thread is pinned to, -1 for any
+    QString inputBackend;     // "epoll" or "io_uring"
+
+    // AO output engine
+    QString aoOutputEngine;       // "Instant", "Buffered" or "Simulated"
+    int streamRate;               // Buffered AO sample rate per channel in Hz
+    QString streamInterpolation;  // "Linear" or "Cubic"
+    int streamRefillInterval;     // Buffered AO refill interval in milliseconds
+
     // Joystick settings
-    QString joystickBackend;  // "Auto", "Legacy", or "Libinput"
+    QString joystickBackend;  // "Auto", "Legacy", "Libinput" or "Evdev"
     double deadzone;
     double xScale;
     double yScale;
     bool invertX;
     bool invertY;
 
+    // Per-axis filter pipelines
+    AxisFilterConfig xFilter;
+    AxisFilterConfig yFilter;
+
     // Constructor with default values
     ConfigureParameter() :
         aiDeviceName(""),
@@ -46,6 +67,8 @@ struct ConfigureParameter
         aoProfilePath(""),
         aiChannelStart(0),
         aiChannelCount(2),
+        aiMirrorXChannel(0),
+        aiMirrorYChannel(1),
         aiValueRange(V_ExternalRefBipolar),
         clockRatePerChan(1000),
         sectionLength(1024),
@@ -53,6 +76,16 @@ struct ConfigureParameter
         aoChannelCount(2),
         aoValueRange(V_ExternalRefBipolar),
         pointCountPerWave(400),
+        controlRate(1000),
+        realtimeControl(false),
+        outputMode("Periodic"),
+        minWriteInterval(1000),
+        inputCpu(-1),
+        inputBackend("epoll"),
+        aoOutputEngine("Instant"),
+        streamRate(50000),
+        streamInterpolation("Linear"),
+        streamRefillInterval(5),
         joystickBackend("Auto"),
         deadzone(0.05),
         xScale(1.0),
@@ -77,6 +110,7 @@ public:
     void Initialization();
     void CheckError(ErrorCode errorCode);
     ConfigureParameter GetConfigureParameter() { return configure; }
+    void SetConfigureParameter(const ConfigureParameter& value) { configure = value; }
     void RefreshConfigureParameter();
 
 private:
@@ -91,6 +125,7 @@ private slots:
     void AIButtonBrowseClicked();
     void AOButtonBrowseClicked();
     void TabChanged(int index);
+    void OutputEngineChanged(int index);
 
     // New joystick-related slots
     void JoystickBackendChanged(int index);
@@ -0,0 +1,630 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "control_thread.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <algorithm>
+#include <cmath>
+#include <errno.h>
+#include <iomanip>
+#include <limits>
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static inline int64_t timespecToNs(const struct timespec& ts)
+{
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Bounds for the filter time step; the upper one covers stalls and the
+// first tick after start
+static const double MinFilterTimeStep = 1e-6;
+static const double MaxFilterTimeStep = 0.1;
+
+// Reports older than this at the output were made before the loop could see
+// them, e.g. the last report of an idle stick when the loop starts
+static const int64_t MaxInputLatency = 100000000;
+
+static inline struct timespec nsToTimespec(int64_t ns)
+{
+    struct timespec ts;
+    ts.tv_sec = ns / 1000000000LL;
+    ts.tv_nsec = ns % 1000000000LL;
+    return ts;
+}
+
+static inline int64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return timespecToNs(ts);
+}
+
+ControlThread::ControlThread(QObject* parent)
+    : QThread(parent),
+      m_aoCtrl(nullptr),
+      m_aoStream(nullptr),
+      m_streaming(false),
+      m_rate(1000),
+      m_realtime(false),
+      m_priority(80),
+      m_outputMode(Periodic),
+      m_minWriteInterval(1000000),
+      m_wakeupFd(-1),
+      m_settingsGeneration(0),
+      m_centerRequested(false),
+      m_holdRequests(0),
+      m_releaseRequests(0),
+      m_appliedGeneration(0),
+      m_lastTickTime(0),
+      m_filterFrame(0),
+      m_filterTimestamp(0),
+      m_outputInputTime(0),
+      m_filterHeld(0.0),
+      m_lastError(Success),
+      m_tickCount(0),
+      m_missedDeadlines(0)
+{
+    for (int i = 0; i < AoTransform::MaxChannels; i++) {
+        m_aoData[i] = 0.0;
+    }
+
+    m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeupFd < 0) {
+        qWarning() << "Failed to create control loop wakeup fd:" << strerror(errno);
+    }
+}
+
+ControlThread::~ControlThread()
+{
+    stop();
+
+    if (m_wakeupFd >= 0) {
+        close(m_wakeupFd);
+        m_wakeupFd = -1;
+    }
+}
+
+void ControlThread::setAoCtrl(InstantAoCtrl* ctrl, const AoTransform& transform)
+{
+    Q_ASSERT(!isRunning());
+    m_aoCtrl = ctrl;
+    m_aoTransform = transform;
+
+    // Channels that are not mapped rest at the middle of their range
+    for (int i = 0; i < transform.getChannelCount(); i++) {
+        m_aoData[i] = transform.channel(transform.getChannelStart() + i).apply(0.0);
+    }
+}
+
+void ControlThread::setAoStream(AoStream* stream)
+{
+    Q_ASSERT(!isRunning());
+    m_aoStream = stream;
+}
+
+void ControlThread::setRate(int hz)
+{
+    Q_ASSERT(!isRunning());
+    if (hz < MinRate) hz = MinRate;
+    if (hz > MaxRate) hz = MaxRate;
+    m_rate = hz;
+}
+
+void ControlThread::setRealtime(bool enabled, int priority)
+{
+    Q_ASSERT(!isRunning());
+    m_realtime = enabled;
+    m_priority = priority;
+}
+
+void ControlThread::setOutputMode(OutputMode mode, int minWriteInterval)
+{
+    Q_ASSERT(!isRunning());
+    m_outputMode = mode;
+    m_minWriteInterval = static_cast<int64_t>(minWriteInterval < 0 ? 0 : minWriteInterval) * 1000;
+}
+
+void ControlThread::setSettings(const ControlSettings& settings)
+{
+    QMutexLocker locker(&m_settingsMutex);
+    m_pendingSettings = settings;
+    m_settingsGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void ControlThread::setInputSource(const JoystickSnapshotSource& source, int input)
+{
+    Q_ASSERT(input >= 0 && input < ControlSettings::MaxInputs);
+
+    QMutexLocker locker(&m_settingsMutex);
+    m_pendingSources[input] = source;
+    m_settingsGeneration.fetch_add(1, std::memory_order_release);
+}
+
+void ControlThread::notifyInput()
+{
+    if (m_outputMode == EventDriven && m_wakeupFd >= 0) {
+        uint64_t one = 1;
+        ssize_t result = write(m_wakeupFd, &one, sizeof(one));
+        (void)result;
+    }
+}
+
+void ControlThread::publishMeasurement(double x, double y)
+{
+    MirrorMeasurement measurement;
+    measurement.x = x;
+    measurement.y = y;
+    m_measurement.store(measurement);
+}
+
+void ControlThread::center()
+{
+    m_centerRequested.store(true, std::memory_order_release);
+}
+
+void ControlThread::holdInput(int input)
+{
+    Q_ASSERT(input >= 0 && input < ControlSettings::MaxInputs);
+    m_holdRequests.fetch_or(1U << input, std::memory_order_release);
+}
+
+void ControlThread::releaseInput(int input)
+{
+    Q_ASSERT(input >= 0 && input < ControlSettings::MaxInputs);
+    m_releaseRequests.fetch_or(1U << input, std::memory_order_release);
+}
+
+void ControlThread::stop()
+{
+    requestInterruption();
+    wait();
+}
+
+void ControlThread::run()
+{
+    if (m_realtime) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = m_priority;
+
+        int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (result != 0) {
+            qWarning() << "Failed to enable SCHED_FIFO for control thread:" << strerror(result);
+        }
+    }
+
+    // Filter coefficients depend on the loop rate
+    m_xFilter.configure(m_settings.xFilter, m_rate);
+    m_yFilter.configure(m_settings.yFilter, m_rate);
+    m_lastTickTime = 0;
+    m_filterTimestamp = 0;
+    m_outputInputTime = 0;
+
+    for (int i = 0; i < StageCount; i++) {
+        m_histograms[i].reset();
+    }
+    m_missedDeadlines.store(0, std::memory_order_relaxed);
+
+    const int64_t period = 1000000000LL / m_rate;
+    const bool eventDriven = (m_outputMode == EventDriven && m_wakeupFd >= 0 && !m_aoStream);
+    if (m_outputMode == EventDriven && m_aoStream) {
+        qWarning() << "Event-driven output does not apply to a stream, running periodically";
+    }
+
+    const int64_t start = monotonicNs();
+    int64_t deadline = start;
+
+    // The hardware clock runs for as long as the loop feeds it
+    if (m_aoStream) {
+        ErrorCode errorCode = m_aoStream->start(start, m_aoData);
+        m_streaming = !BioFailed(errorCode);
+        if (!m_streaming) {
+            m_lastError = errorCode;
+            emit aoWriteFailed(errorCode);
+        }
+    }
+
+    while (!isInterruptionRequested()) {
+        if (eventDriven) {
+            // Write immediately on input, but never closer than the minimum interval
+            int64_t tickTime = tick(deadline, start);
+
+            // Without input the loop keeps ticking at the control rate so the
+            // filters still settle
+            deadline = tickTime + period;
+            if (waitForInput(deadline)) {
+                deadline = std::max(monotonicNs(), tickTime + m_minWriteInterval);
+                struct timespec earliest = nsToTimespec(deadline);
+                while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &earliest, nullptr) == EINTR) {
+                }
+            }
+            continue;
+        }
+
+        tick(deadline, start);
+
+        // Advance to the next absolute deadline, skipping ticks we have missed
+        deadline += period;
+        int64_t now = monotonicNs();
+        if (now > deadline) {
+            deadline = now;
+        }
+
+        struct timespec wakeup = nsToTimespec(deadline);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr) == EINTR) {
+        }
+    }
+
+    if (m_streaming) {
+        m_aoStream->stop();
+        m_streaming = false;
+    }
+}
+
+bool ControlThread::waitForInput(int64_t deadline)
+{
+    struct pollfd pfd;
+    pfd.fd = m_wakeupFd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    while (true) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t remaining = deadline - timespecToNs(now);
+        if (remaining < 0) {
+            remaining = 0;
+        }
+
+        struct timespec timeout = nsToTimespec(remaining);
+        int result = ppoll(&pfd, 1, &timeout, nullptr);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (result > 0) {
+            // Drain the counter; several frames since the last tick coalesce
+            uint64_t count = 0;
+            ssize_t len = read(m_wakeupFd, &count, sizeof(count));
+            (void)len;
+            return true;
+        }
+
+        return false;
+    }
+}
+
+int64_t ControlThread::tick(int64_t target, int64_t start)
+{
+    const int64_t tickStart = monotonicNs();
+
+    // Pick up new settings only when the GUI changed them
+    uint32_t generation = m_settingsGeneration.load(std::memory_order_acquire);
+    if (generation != m_appliedGeneration) {
+        QMutexLocker locker(&m_settingsMutex);
+
+        // Rebuilding the filter chains does not allocate, but only do it when needed
+        if (m_pendingSettings.xFilter != m_settings.xFilter) {
+            m_xFilter.configure(m_pendingSettings.xFilter, m_rate);
+        }
+        if (m_pendingSettings.yFilter != m_settings.yFilter) {
+            m_yFilter.configure(m_pendingSettings.yFilter, m_rate);
+        }
+
+        m_settings = m_pendingSettings;
+        for (int i = 0; i < ControlSettings::MaxInputs; i++) {
+            m_inputs[i].source = m_pendingSources[i];
+        }
+        m_appliedGeneration = generation;
+    }
+
+    // Read one consistent report of every input back to back, X and Y of a
+    // joystick always come from the same frame
+    JoystickSnapshot inputs[ControlSettings::MaxInputs];
+    for (int i = 0; i < ControlSettings::MaxInputs; i++) {
+        if (m_inputs[i].source) {
+            inputs[i] = m_inputs[i].source->load();
+        }
+    }
+    const int64_t inputDone = monotonicNs();
+
+    // Report times are microseconds on the loop clock
+    int64_t inputTime = 0;
+    for (int i = 0; i < ControlSettings::MaxInputs; i++) {
+        if (m_inputs[i].source) {
+            inputTime = std::max(inputTime, inputs[i].timestamp * 1000);
+        }
+    }
+
+    const bool centering = m_centerRequested.exchange(false, std::memory_order_acq_rel);
+    if (centering) {
+        m_xFilter.reset(0.0);
+        m_yFilter.reset(0.0);
+    }
+
+    // Sum the inputs, normalized to -1.0 to 1.0
+    double x = 0.0;
+    double y = 0.0;
+    mixInputs(inputs, centering, x, y);
+
+    // Run the per-axis filter chains over the real time since the last sample,
+    // the first input provides the device clock
+    double dt = filterTimeStep(inputs[0], tickStart);
+    double filteredX = m_xFilter.process(x, dt);
+    double filteredY = m_yFilter.process(y, dt);
+
+    // Apply inversion and scaling
+    double xSign = m_settings.invertX ? -1.0 : 1.0;
+    double ySign = m_settings.invertY ? -1.0 : 1.0;
+    x *= xSign * m_settings.xScale;
+    y *= ySign * m_settings.yScale;
+    filteredX *= xSign * m_settings.xScale;
+    filteredY *= ySign * m_settings.yScale;
+
+    const int64_t filterDone = monotonicNs();
+
+    // Update mirror position
+    double xVolts = 0.0;
+    double yVolts = 0.0;
+    int64_t transformDone = filterDone;
+    const bool output = m_streaming || m_aoCtrl;
+    if (output) {
+        updateMirrorPosition(filteredX, filteredY, xVolts, yVolts);
+        transformDone = monotonicNs();
+        writeMirrorPosition(tickStart);
+    }
+    const int64_t tickEnd = monotonicNs();
+
+    // A streamed command plays once the waveform catches up with it
+    int64_t outputTime = 0;
+    if (output) {
+        outputTime = m_streaming ? tickStart + m_aoStream->getLag() : tickEnd;
+    }
+
+    m_histograms[WakeupLatency].record(tickStart - target);
+    m_histograms[InputRead].record(inputDone - tickStart);
+    m_histograms[Filtering].record(filterDone - inputDone);
+    if (output) {
+        m_histograms[Transform].record(transformDone - filterDone);
+        m_histograms[AoWrite].record(tickEnd - transformDone);
+    }
+    m_histograms[TickTotal].record(tickEnd - tickStart);
+
+    // Measure each report once, at the first command that carries it
+    if (output && inputTime > m_outputInputTime) {
+        int64_t latency = outputTime - inputTime;
+        if (latency >= 0 && latency <= MaxInputLatency) {
+            m_histograms[InputToOutput].record(latency);
+        }
+        m_outputInputTime = inputTime;
+    }
+
+    // The next tick was due before this one finished
+    if (tickEnd > target + 1000000000LL / m_rate) {
+        m_missedDeadlines.store(m_missedDeadlines.load(std::memory_order_relaxed) + 1,
+                                std::memory_order_relaxed);
+    }
+
+    MirrorMeasurement measurement = m_measurement.load();
+
+    ControlSnapshot snapshot;
+    snapshot.time = (target - start) * 1e-9;
+    snapshot.x = x;
+    snapshot.y = y;
+    snapshot.smoothedX = filteredX;
+    snapshot.smoothedY = filteredY;
+    snapshot.xVolts = xVolts;
+    snapshot.yVolts = yVolts;
+    snapshot.measuredX = measurement.x;
+    snapshot.measuredY = measurement.y;
+    snapshot.inputTime = inputTime;
+    snapshot.outputTime = outputTime;
+    snapshot.tickCount = ++m_tickCount;
+    m_snapshot.store(snapshot);
+    m_telemetry.push(snapshot);
+
+    return tickStart;
+}
+
+void ControlThread::mixInputs(const JoystickSnapshot* inputs, bool centering, double& x, double& y)
+{
+    uint32_t holds = m_holdRequests.exchange(0, std::memory_order_acq_rel);
+    uint32_t releases = m_releaseRequests.exchange(0, std::memory_order_acq_rel);
+
+    for (int i = 0; i < ControlSettings::MaxInputs; i++) {
+        InputState& state = m_inputs[i];
+        const JoystickSnapshot& input = inputs[i];
+        const InputMapping& mapping = m_settings.inputs[i];
+
+        if (holds & (1U << i)) {
+            state.holding = true;
+            state.holdSource = state.source;
+        }
+        if (releases & (1U << i)) {
+            state.holding = false;
+            state.holdSource.reset();
+        }
+
+        // The replacement device has reported, continue from its input. The gap
+        // to the last report of the old device is no sample step, so the
+        // filters run on loop time.
+        if (state.holding && state.source && state.source != state.holdSource && input.frame != 0) {
+            state.holding = false;
+            state.holdSource.reset();
+            if (i == 0) {
+                m_filterTimestamp = 0;
+            }
+        }
+
+        if (centering) {
+            state.centerFrame = input.frame;
+            state.centered = true;
+            state.holding = false;
+            state.holdSource.reset();
+        }
+
+        if (state.centered && input.frame != state.centerFrame) {
+            state.centered = false;
+        }
+
+        // A held input keeps its last position while its joystick is away
+        if (!state.holding) {
+            state.x = 0.0;
+            state.y = 0.0;
+            if (!state.centered && state.source) {
+                state.x = std::max(-1.0, std::min(1.0, input.axis(mapping.xAxis) / 32767.0));
+                state.y = std::max(-1.0, std::min(1.0, input.axis(mapping.yAxis) / 32767.0));
+                applyDeadzone(state.x, state.y);
+            }
+        }
+
+        x += state.x * mapping.gain;
+        y += state.y * mapping.gain;
+    }
+
+    x = std::max(-1.0, std::min(1.0, x));
+    y = std::max(-1.0, std::min(1.0, y));
+}
+
+double ControlThread::filterTimeStep(const JoystickSnapshot& input, int64_t now)
+{
+    double elapsed = m_lastTickTime ? (now - m_lastTickTime) * 1e-9 : 1.0 / m_rate;
+    m_lastTickTime = now;
+
+    double dt = elapsed;
+    if (input.frame != m_filterFrame) {
+        // A new report: the device timestamps give the true spacing of the
+        // samples. Time already spent holding the previous sample counts
+        // against it, so the filter clock follows the device clock.
+        if (m_filterTimestamp > 0 && input.timestamp > m_filterTimestamp) {
+            dt = (input.timestamp - m_filterTimestamp) * 1e-6 - m_filterHeld;
+        }
+        m_filterFrame = input.frame;
+        m_filterTimestamp = input.timestamp;
+        m_filterHeld = 0.0;
+    } else {
+        // No new report: the last sample is held for the elapsed loop time
+        m_filterHeld += elapsed;
+    }
+
+    return std::max(MinFilterTimeStep, std::min(MaxFilterTimeStep, dt));
+}
+
+void ControlThread::applyDeadzone(double& x, double& y) const
+{
+    // Calculate distance from center
+    double distance = std::sqrt(x * x + y * y);
+    double deadzone = m_settings.deadzone;
+
+    if (distance <= deadzone) {
+        // Inside deadzone - set to zero
+        x = 0.0;
+        y = 0.0;
+    } else {
+        // Outside deadzone - rescale to remove discontinuity
+        double factor = (distance - deadzone) / (1.0 - deadzone);
+        x = x * factor / distance;
+        y = y * factor / distance;
+    }
+}
+
+void ControlThread::updateMirrorPosition(double x, double y, double& xVolts, double& yVolts)
+{
+    // Each channel has its own precomputed range, so mixed ranges map correctly
+    int start = m_aoTransform.getChannelStart();
+
+    if (m_aoTransform.contains(m_settings.xChannel)) {
+        xVolts = m_aoTransform.channel(m_settings.xChannel).apply(x);
+        m_aoData[m_settings.xChannel - start] = xVolts;
+    }
+
+    if (m_aoTransform.contains(m_settings.yChannel)) {
+        yVolts = m_aoTransform.channel(m_settings.yChannel).apply(y);
+        m_aoData[m_settings.yChannel - start] = yVolts;
+    }
+}
+
+void ControlThread::writeMirrorPosition(int64_t time)
+{
+    // Write to the DAQ, reporting only changes in error state to the GUI
+    ErrorCode errorCode = Success;
+    if (m_streaming) {
+        // The stream interpolates towards this command in the next refills
+        m_aoStream->pushCommand(time, m_aoData);
+        errorCode = m_aoStream->refill(time);
+    } else {
+        errorCode = m_aoCtrl->Write(m_aoTransform.getChannelStart(),
+                                    m_aoTransform.getChannelCount(), m_aoData);
+    }
+
+    if (errorCode != m_lastError) {
+        m_lastError = errorCode;
+        if (BioFailed(errorCode)) {
+            emit aoWriteFailed(errorCode);
+        }
+    }
+}
+
+void ControlThread::writeStatistics(std::ostream& out) const
+{
+    out << "Control loop statistics (times in microseconds)" << "\n";
+    out << "Missed deadlines: " << missedDeadlines() << "\n\n";
+
+    out << std::left << std::setw(16) << "Stage" << std::right
+        << std::setw(12) << "Count" << std::setw(10) << "p50" << std::setw(10) << "p99"
+        << std::setw(10) << "p99.9" << std::setw(10) << "Max" << "\n";
+
+    out << std::fixed << std::setprecision(1);
+    for (int i = 0; i < StageCount; i++) {
+        const LatencyHistogram& h = m_histograms[i];
+        out << std::left << std::setw(16) << stageName(static_cast<Stage>(i)) << std::right
+            << std::setw(12) << h.count()
+            << std::setw(10) << h.percentile(50.0) / 1000.0
+            << std::setw(10) << h.percentile(99.0) / 1000.0
+            << std::setw(10) << h.percentile(99.9) / 1000.0
+            << std::setw(10) << h.max() / 1000.0 << "\n";
+    }
+
+    // Raw buckets so the distributions can be plotted offline
+    for (int i = 0; i < StageCount; i++) {
+        out << "\n# " << stageName(static_cast<Stage>(i)) << ": lower_ns upper_ns count\n";
+        m_histograms[i].writeBuckets(out);
+    }
+}
+
+const char* ControlThread::stageName(Stage stage)
+{
+    switch (stage) {
+        case WakeupLatency: return "Wakeup latency";
+        case InputRead:     return "Input read";
+        case Filtering:     return "Filtering";
+        case Transform:     return "Transform";
+        case AoWrite:       return "AO write";
+        case TickTotal:     return "Tick total";
+        case InputToOutput: return "Input to AO";
+        case StageCount:    break;
+    }
+    return "Unknown";
+}
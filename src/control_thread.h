@@ -0,0 +1,374 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTROL_THREAD_H
+#define CONTROL_THREAD_H
+
+#include <QThread>
+#include <QMutex>
+#include <atomic>
+#include <limits>
+#include <ostream>
+#include <stdint.h>
+
+// Advantech DAQ headers
+#include "../../inc/bdaqctrl.h"
+using namespace Automation::BDaq;
+
+#include "ao_stream.h"
+#include "ao_transform.h"
+#include "filter_pipeline.h"
+#include "joystick_state.h"
+#include "utils/latency_histogram.h"
+#include "utils/seqlock.h"
+#include "utils/spsc_ring.h"
+
+/**
+ * How one joystick contributes to the mirror command
+ */
+struct InputMapping {
+    int xAxis;              // Joystick axis driving X
+    int yAxis;              // Joystick axis driving Y
+    double gain;            // Weight of the joystick in the sum of all inputs
+
+    InputMapping() :
+        xAxis(0),
+        yAxis(1),
+        gain(1.0)
+    {}
+};
+
+/**
+ * Settings used by the control loop, copied into the thread on change
+ */
+struct ControlSettings {
+    // Joysticks mixed into one command, e.g. a coarse and a fine stick
+    static const int MaxInputs = 4;
+
+    int xChannel;           // Physical AO channel for X
+    int yChannel;           // Physical AO channel for Y
+    InputMapping inputs[MaxInputs];     // Mapping and gain of each input
+    bool invertX;           // Whether to invert X axis
+    bool invertY;           // Whether to invert Y axis
+    double xScale;          // Scaling factor for X
+    double yScale;          // Scaling factor for Y
+    double deadzone;        // Deadzone radius
+    AxisFilterConfig xFilter;   // Filter chain for X
+    AxisFilterConfig yFilter;   // Filter chain for Y
+
+    ControlSettings() :
+        xChannel(0),
+        yChannel(1),
+        invertX(false),
+        invertY(false),
+        xScale(1.0),
+        yScale(1.0),
+        deadzone(0.05)
+    {}
+};
+
+/**
+ * Mirror position measured outside the loop, e.g. by the AI device
+ */
+struct MirrorMeasurement {
+    double x = std::numeric_limits<double>::quiet_NaN();  // Measured X in volts, NaN if not measured
+    double y = std::numeric_limits<double>::quiet_NaN();  // Measured Y in volts, NaN if not measured
+};
+
+/**
+ * State published by the control loop for the GUI, once per tick
+ */
+struct ControlSnapshot {
+    double time;            // Seconds since the loop was started
+    double x;               // X after deadzone, inversion and scaling
+    double y;               // Y after deadzone, inversion and scaling
+    double smoothedX;       // X after filtering, sent to the mirror (normalized)
+    double smoothedY;       // Y after filtering, sent to the mirror (normalized)
+    double xVolts;          // X output voltage
+    double yVolts;          // Y output voltage
+    double measuredX;       // Latest measured X in volts, NaN without a measurement
+    double measuredY;       // Latest measured Y in volts, NaN without a measurement
+    int64_t inputTime;      // CLOCK_MONOTONIC ns of the newest report in the command, 0 without input
+    int64_t outputTime;     // CLOCK_MONOTONIC ns the command reaches the AO output, 0 without output
+    uint64_t tickCount;     // Number of completed control ticks
+};
+
+/**
+ * Real-time control loop driving the mirror
+ *
+ * Wakes on absolute CLOCK_MONOTONIC deadlines, applies deadzone, the per-axis
+ * filter pipelines and scaling to the latest joystick input and writes the
+ * result to the AO device. Several joysticks can be open at once: each
+ * input is deadzoned and weighted with its gain, and the sum of all inputs
+ * is what gets filtered. In event-driven mode it also wakes as soon as an input frame is
+ * reported through notifyInput(). The GUI only reads snapshots published by
+ * the loop.
+ *
+ * Joysticks stamp their reports with the kernel event time on
+ * CLOCK_MONOTONIC, the clock of the loop, so every tick records when its
+ * newest report happened and when the command reaches the output.
+ */
+class ControlThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    static const int MinRate = 250;
+    static const int MaxRate = 5000;
+
+    // Ticks buffered for the GUI, about 0.8 s at the maximum rate
+    static const size_t TelemetryCapacity = 4096;
+
+    // When the loop writes to the AO device
+    enum OutputMode {
+        Periodic,       // Once per period of the control rate
+        EventDriven     // As soon as an input frame arrives, rate limited
+    };
+
+    // Parts of a tick timed by the loop
+    enum Stage {
+        WakeupLatency,  // Wakeup past the time the loop meant to run
+        InputRead,      // Settings pickup and snapshot load
+        Filtering,      // Deadzone and filter pipelines
+        Transform,      // Conversion to volts and channel mapping
+        AoWrite,        // Write to the AO device
+        TickTotal,      // Whole tick
+        InputToOutput,  // Device report to the first command carrying it at the output
+        StageCount
+    };
+
+    explicit ControlThread(QObject* parent = nullptr);
+    ~ControlThread() override;
+
+    /**
+     * Set the AO control the loop writes to (only while stopped)
+     * @param ctrl Instant AO control, or nullptr to disable output
+     * @param transform Voltage transforms of the written channels
+     */
+    void setAoCtrl(InstantAoCtrl* ctrl, const AoTransform& transform = AoTransform());
+
+    /**
+     * Stream to a buffered AO device instead of writing instantly (only while stopped)
+     * @param stream Configured stream, started and stopped with the loop,
+     *               or nullptr for instant writes
+     */
+    void setAoStream(AoStream* stream);
+
+    /**
+     * Set the loop rate (only while stopped)
+     * @param hz Loop rate in Hz, clamped to [MinRate, MaxRate]
+     */
+    void setRate(int hz);
+    int getRate() const { return m_rate; }
+
+    /**
+     * Request SCHED_FIFO scheduling for the loop (only while stopped)
+     * @param enabled Whether to use real-time scheduling
+     * @param priority SCHED_FIFO priority (1-99)
+     */
+    void setRealtime(bool enabled, int priority = 80);
+
+    /**
+     * Set the output mode (only while stopped)
+     * An AO stream is always fed periodically, its command history holds
+     * one command per control tick.
+     * @param mode Output mode
+     * @param minWriteInterval Minimum time between AO writes in microseconds
+     *                         (event-driven mode only)
+     */
+    void setOutputMode(OutputMode mode, int minWriteInterval = 1000);
+    OutputMode getOutputMode() const { return m_outputMode; }
+
+    /**
+     * Update the loop settings, picked up at the start of the next tick
+     * @param settings New settings
+     */
+    void setSettings(const ControlSettings& settings);
+
+    /**
+     * Set the joystick one input of the loop reads from
+     * @param source Snapshot buffer of the joystick, or nullptr for no input
+     * @param input Input number, below ControlSettings::MaxInputs
+     */
+    void setInputSource(const JoystickSnapshotSource& source, int input = 0);
+
+    /**
+     * Signal that the input source has published a new report.
+     * Safe to call from any thread; wakes the loop in event-driven mode.
+     */
+    void notifyInput();
+
+    /**
+     * Publish the latest measured mirror position, recorded with every tick.
+     * Only the AI callback thread may call this, it publishes NaN itself
+     * when acquisition stops. The position is NaN until the first call.
+     * @param x Measured X in volts, NaN if not measured
+     * @param y Measured Y in volts, NaN if not measured
+     */
+    void publishMeasurement(double x, double y);
+
+    /**
+     * Zero the input until the joystick reports again, and reset the filters
+     */
+    void center();
+
+    /**
+     * Keep the last position of one input, without reading it, until a source
+     * set for it after this call reports. Used while a joystick reconnects;
+     * center() ends the hold as well.
+     * @param input Input number, below ControlSettings::MaxInputs
+     */
+    void holdInput(int input);
+
+    /**
+     * End the hold of one input, it reads as zero until it has a source again
+     * @param input Input number, below ControlSettings::MaxInputs
+     */
+    void releaseInput(int input);
+
+    /**
+     * Stop the loop and wait for the thread to exit
+     */
+    void stop();
+
+    /**
+     * Get the last state published by the loop
+     * @return Snapshot of the loop state
+     */
+    ControlSnapshot snapshot() const { return m_snapshot.load(); }
+
+    /**
+     * Take the ticks recorded since the last call, oldest first (GUI thread only)
+     * @param out Destination for the records
+     * @param maxCount Size of out
+     * @return Number of records copied
+     */
+    size_t drainTelemetry(ControlSnapshot* out, size_t maxCount) { return m_telemetry.pop(out, maxCount); }
+
+    /**
+     * Discard recorded ticks (GUI thread only)
+     */
+    void clearTelemetry() { m_telemetry.clear(); }
+
+    /**
+     * Get the number of ticks not recorded because the GUI fell behind
+     */
+    size_t telemetryDropped() const { return m_telemetry.dropped(); }
+
+    /**
+     * Get the timing histogram of one stage, cleared when the loop starts
+     * @param stage Stage of the tick
+     * @return Histogram of durations in nanoseconds
+     */
+    const LatencyHistogram& histogram(Stage stage) const { return m_histograms[stage]; }
+
+    /**
+     * Get the number of ticks that finished after the next one was due
+     */
+    uint64_t missedDeadlines() const { return m_missedDeadlines.load(std::memory_order_relaxed); }
+
+    /**
+     * Write percentiles and raw buckets of every stage
+     * @param out Destination stream
+     */
+    void writeStatistics(std::ostream& out) const;
+
+    static const char* stageName(Stage stage);
+
+signals:
+    /**
+     * Emitted (from the control thread) when an AO write starts failing
+     * @param errorCode BDaq error code
+     */
+    void aoWriteFailed(int errorCode);
+
+protected:
+    void run() override;
+
+private:
+    int64_t tick(int64_t target, int64_t start);
+    void mixInputs(const JoystickSnapshot* inputs, bool centering, double& x, double& y);
+    double filterTimeStep(const JoystickSnapshot& input, int64_t now);
+    bool waitForInput(int64_t deadline);
+    void applyDeadzone(double& x, double& y) const;
+    void updateMirrorPosition(double x, double y, double& xVolts, double& yVolts);
+    void writeMirrorPosition(int64_t time);
+
+    InstantAoCtrl* m_aoCtrl;
+    AoTransform m_aoTransform;
+    AoStream* m_aoStream;
+    bool m_streaming;               // m_aoStream was started by run()
+    int m_rate;
+    bool m_realtime;
+    int m_priority;
+    OutputMode m_outputMode;
+    int64_t m_minWriteInterval;     // Nanoseconds
+    int m_wakeupFd;                 // eventfd signalled by notifyInput()
+
+    // Settings and input source handed over from the GUI thread
+    QMutex m_settingsMutex;
+    ControlSettings m_pendingSettings;
+    JoystickSnapshotSource m_pendingSources[ControlSettings::MaxInputs];
+    std::atomic<uint32_t> m_settingsGeneration;
+    std::atomic<bool> m_centerRequested;
+    std::atomic<uint32_t> m_holdRequests;   // Bit per input
+    std::atomic<uint32_t> m_releaseRequests;
+
+    // Per input state, owned by the control thread
+    struct InputState {
+        JoystickSnapshotSource source;
+        JoystickSnapshotSource holdSource;  // Source at the time of the hold
+        bool holding;                       // Position below is kept, not read
+        bool centered;
+        uint64_t centerFrame;               // Input is held at zero while this is the latest frame
+        double x;                           // Last position, normalized and after the deadzone
+        double y;
+
+        InputState() :
+            holding(false),
+            centered(false),
+            centerFrame(0),
+            x(0.0),
+            y(0.0)
+        {}
+    };
+
+    // State owned by the control thread
+    ControlSettings m_settings;
+    InputState m_inputs[ControlSettings::MaxInputs];
+    uint32_t m_appliedGeneration;
+    FilterPipeline m_xFilter;
+    FilterPipeline m_yFilter;
+    int64_t m_lastTickTime;         // CLOCK_MONOTONIC ns of the previous tick, 0 before the first
+    uint64_t m_filterFrame;         // Last input frame fed to the filters
+    int64_t m_filterTimestamp;      // Device timestamp of that frame in microseconds
+    int64_t m_outputInputTime;      // Newest report time already measured at the output, ns
+    double m_filterHeld;            // Seconds the filters advanced since that frame
+    double m_aoData[AoTransform::MaxChannels];
+    ErrorCode m_lastError;
+    uint64_t m_tickCount;
+
+    // Instrumentation, written by the control thread only
+    LatencyHistogram m_histograms[StageCount];
+    std::atomic<uint64_t> m_missedDeadlines;
+
+    SeqLock<MirrorMeasurement> m_measurement;
+    SeqLock<ControlSnapshot> m_snapshot;
+    SpscRing<ControlSnapshot, TelemetryCapacity> m_telemetry;
+};
+
+#endif // CONTROL_THREAD_H
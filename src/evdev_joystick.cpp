@@ -0,0 +1,385 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**  
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "evdev_joystick.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <QDir>
+#include <QFileInfo>
+#include <QDebug>
+#include <QSocketNotifier>
+
+#include "utils/evdev_helper.h"
+#include "utils/input_device_index.h"
+
+static inline bool testBit(const unsigned long* bits, int nr)
+{
+    return (bits[BIT_WORD(nr)] & BIT_MASK(nr)) != 0;
+}
+
+static std::string errorString(const std::string& filename)
+{
+    return QString("%1: %2").arg(QString::fromStdString(filename)).arg(strerror(errno)).toStdString();
+}
+
+// Default correction of the kernel joydev driver: center the range,
+// treat the flat area as deadzone and scale to -32767..32767
+static struct js_corr defaultCorrection(const struct input_absinfo& abs)
+{
+    struct js_corr corr;
+    memset(&corr, 0, sizeof(corr));
+
+    corr.type = JS_CORR_BROKEN;
+    corr.prec = abs.fuzz;
+    corr.coef[0] = (abs.maximum + abs.minimum) / 2 - abs.flat;
+    corr.coef[1] = (abs.maximum + abs.minimum) / 2 + abs.flat;
+
+    int t = (abs.maximum - abs.minimum) / 2 - 2 * abs.flat;
+    if (t) {
+        corr.coef[2] = (1 << 29) / t;
+        corr.coef[3] = (1 << 29) / t;
+    }
+
+    return corr;
+}
+
+EvdevJoystick::EvdevJoystick(const std::string& device_path)
+    : Joystick(),
+      m_dropped(false)
+{
+    filename = findEventDevice(device_path);
+
+    if ((fd = open(filename.c_str(), O_RDONLY | O_NONBLOCK)) < 0) {
+        throw std::runtime_error(errorString(filename));
+    }
+
+    // Stamp events on the clock the control loop uses
+    if (!event_clock.selectMonotonic(fd)) {
+        qWarning() << "Event times of" << QString::fromStdString(filename) << "stay on CLOCK_REALTIME:" << strerror(errno);
+    }
+
+    // The base destructor closes fd if this throws
+    initDevice();
+
+    m_orig_correction = m_correction;
+    orig_calibration_data = getCalibration();
+
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &EvdevJoystick::onSocketActivated,
+            Qt::DirectConnection);
+    notifier->setEnabled(true);
+
+    qDebug() << "EvdevJoystick initialized:" << name << "with" << axis_count << "axes and" << button_count << "buttons";
+}
+
+EvdevJoystick::~EvdevJoystick()
+{
+}
+
+void EvdevJoystick::initDevice()
+{
+    char name_c_str[256] = "";
+    if (ioctl(fd, EVIOCGNAME(sizeof(name_c_str)), name_c_str) < 0) {
+        throw std::runtime_error(errorString(filename));
+    }
+    orig_name = name_c_str;
+    name = QString::fromUtf8(name_c_str);
+
+    unsigned long evbit[NLONGS(EV_CNT)] = { 0 };
+    unsigned long absbit[NLONGS(ABS_CNT)] = { 0 };
+    unsigned long keybit[NLONGS(KEY_CNT)] = { 0 };
+
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(evbit)), evbit) < 0) {
+        throw std::runtime_error(errorString(filename));
+    }
+    if (testBit(evbit, EV_ABS)) {
+        ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbit)), absbit);
+    }
+    if (testBit(evbit, EV_KEY)) {
+        ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybit)), keybit);
+    }
+
+    // Axes in code order, as numbered by joydev
+    memset(m_absinfo, 0, sizeof(m_absinfo));
+    for (int code = 0; code < ABS_CNT; code++) {
+        if (testBit(absbit, code)) {
+            if (ioctl(fd, EVIOCGABS(code), &m_absinfo[code]) < 0) {
+                throw std::runtime_error(errorString(filename));
+            }
+            m_axis_mapping.push_back(code);
+            m_correction.push_back(defaultCorrection(m_absinfo[code]));
+        }
+    }
+
+    // Joystick and gamepad buttons first, then the other buttons, as numbered by joydev
+    bool has_js_buttons = false;
+    for (int code = BTN_JOYSTICK; code < KEY_CNT; code++) {
+        if (testBit(keybit, code)) {
+            m_button_mapping.push_back(code);
+            has_js_buttons |= code < BTN_DIGI;
+        }
+    }
+    for (int code = BTN_MISC; code < BTN_JOYSTICK; code++) {
+        if (testBit(keybit, code)) {
+            m_button_mapping.push_back(code);
+        }
+    }
+
+    if (m_axis_mapping.empty() || !has_js_buttons) {
+        throw std::runtime_error(filename + ": not a joystick");
+    }
+
+    axis_count = m_axis_mapping.size();
+    button_count = m_button_mapping.size();
+    axis_state.resize(axis_count, 0);
+
+    current_frame.state.axisCount = std::min(axis_count, (int)JoystickSnapshot::MaxAxes);
+    current_frame.state.buttonCount = std::min(button_count, (int)JoystickSnapshot::MaxButtons);
+
+    buildCodeLookup(m_axis_mapping, m_button_mapping);
+    resyncEvdev(m_axis_mapping, m_button_mapping);
+    current_frame.clearChanges();
+    snapshot_buffer->store(current_frame.state);
+}
+
+int EvdevJoystick::convertAxis(int axis, int value) const
+{
+    return applyCorrection(m_correction[axis], value);
+}
+
+void EvdevJoystick::onSocketActivated(int socket)
+{
+    if (socket == fd) {
+        update();
+    }
+}
+
+void EvdevJoystick::update()
+{
+    struct input_event events[ReadBatchSize];
+
+    while (true) {
+        ssize_t len = read(fd, events, sizeof(events));
+
+        if (len < 0) {
+            // EAGAIN is expected with non-blocking mode when no more events
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+
+            std::string errorMsg = errorString(filename);
+            qWarning() << "Error reading from joystick:" << QString::fromStdString(errorMsg);
+            throw std::runtime_error(errorMsg);
+        }
+        else if (len == 0) {
+            // End of file
+            break;
+        }
+        else if (len % sizeof(struct input_event) != 0) {
+            throw std::runtime_error("EvdevJoystick::update(): incomplete read");
+        }
+
+        size_t count = len / sizeof(struct input_event);
+        for (size_t i = 0; i < count; i++) {
+            processEvent(events[i]);
+        }
+
+        // A short read emptied the queue, skip the read that would only return EAGAIN
+        if (count < (size_t)ReadBatchSize) {
+            break;
+        }
+    }
+}
+
+void EvdevJoystick::processEvent(const struct input_event& event)
+{
+    int64_t timestamp = event_clock.toMonotonic(static_cast<int64_t>(event.input_event_sec) * 1000000 +
+                                                event.input_event_usec);
+
+    switch (event.type) {
+        case EV_SYN:
+            if (event.code == SYN_DROPPED) {
+                // The kernel buffer overflowed, the state is unknown until the next report
+                m_dropped = true;
+                report_meter.recordDropped();
+            }
+            else if (event.code == SYN_REPORT) {
+                if (m_dropped) {
+                    m_dropped = false;
+                    resyncEvdev(m_axis_mapping, m_button_mapping);
+                }
+
+                if (current_frame.hasChanges()) {
+                    publishFrame(timestamp);
+                }
+            }
+            break;
+
+        case EV_ABS: {
+            int index = (!m_dropped && event.code < ABS_CNT) ? abs_index[event.code] : -1;
+            if (index >= 0) {
+                int value = applyCorrection(m_correction[index], event.value);
+                if (axis_state[index] != value) {
+                    changeAxis(index, value, timestamp);
+                }
+            }
+            break;
+        }
+
+        case EV_KEY: {
+            // Autorepeat (value 2) does not change the button state
+            int index = (!m_dropped && event.code < KEY_CNT && event.value != 2) ? key_index[event.code] : -1;
+            if (index >= 0) {
+                changeButton(index, event.value != 0, timestamp);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+std::vector<JoystickDescription> EvdevJoystick::getJoysticks()
+{
+    std::vector<JoystickDescription> joysticks;
+
+    // Same test as initDevice(), from sysfs so no device is opened
+    for (const InputDeviceInfo& device : InputDeviceIndex::instance().devices()) {
+        if (device.isJoystick() && !device.evdev.empty() && access(device.evdev.c_str(), R_OK) == 0) {
+            joysticks.push_back(JoystickDescription(device.evdev,
+                                                    device.name,
+                                                    device.axisCount,
+                                                    device.buttonCount,
+                                                    device.hasForceFeedback,
+                                                    device.vendorId,
+                                                    device.productId));
+        }
+    }
+
+    return joysticks;
+}
+
+std::string EvdevJoystick::findEventDevice(const std::string& device_path)
+{
+    QString path = QString::fromStdString(device_path);
+    QString deviceName = QFileInfo(path).fileName();
+
+    // Input device syspaths end in the event node name
+    if (path.startsWith("/sys/") && deviceName.startsWith("event")) {
+        return QDir("/dev/input").filePath(deviceName).toStdString();
+    }
+
+    // A js device shares its parent input device with exactly one event device
+    InputDeviceInfo info;
+    if (path.startsWith("/dev/input/js") && InputDeviceIndex::instance().findByNode(device_path, info) &&
+        !info.evdev.empty()) {
+        return info.evdev;
+    }
+
+    return device_path;
+}
+
+std::vector<Joystick::CalibrationData> EvdevJoystick::getCalibration()
+{
+    std::vector<CalibrationData> data;
+    std::transform(m_correction.begin(), m_correction.end(), std::back_inserter(data), corr2cal);
+    return data;
+}
+
+void EvdevJoystick::setCalibration(const std::vector<CalibrationData>& data)
+{
+    if ((int)data.size() != axis_count) {
+        throw std::runtime_error(filename + ": calibration does not match the number of axes");
+    }
+
+    m_correction.clear();
+    std::transform(data.begin(), data.end(), std::back_inserter(m_correction), cal2corr);
+}
+
+void EvdevJoystick::resetCalibration()
+{
+    m_correction = m_orig_correction;
+}
+
+void EvdevJoystick::clearCalibration()
+{
+    struct js_corr corr;
+    memset(&corr, 0, sizeof(corr));
+    corr.type = JS_CORR_NONE;
+    std::fill(m_correction.begin(), m_correction.end(), corr);
+}
+
+std::vector<int> EvdevJoystick::getButtonMapping()
+{
+    return m_button_mapping;
+}
+
+std::vector<int> EvdevJoystick::getAxisMapping()
+{
+    return m_axis_mapping;
+}
+
+void EvdevJoystick::setButtonMapping(const std::vector<int>& mapping)
+{
+    if ((int)mapping.size() == button_count) {
+        m_button_mapping = mapping;
+        buildCodeLookup(m_axis_mapping, m_button_mapping);
+    }
+}
+
+void EvdevJoystick::setAxisMapping(const std::vector<int>& mapping)
+{
+    if ((int)mapping.size() == axis_count) {
+        m_axis_mapping = mapping;
+        buildCodeLookup(m_axis_mapping, m_button_mapping);
+    }
+}
+
+void EvdevJoystick::correctCalibration(const std::vector<int>& mapping_old, const std::vector<int>& mapping_new)
+{
+    if ((int)mapping_new.size() != axis_count) {
+        return;
+    }
+
+    int axes[ABS_CNT]; // axes[code] -> old_idx
+    std::fill(axes, axes + ABS_CNT, -1);
+    for (int i = 0; i < (int)mapping_old.size(); i++) {
+        if (mapping_old[i] >= 0 && mapping_old[i] < ABS_CNT) {
+            axes[mapping_old[i]] = i;
+        }
+    }
+
+    std::vector<struct js_corr> corr_new;
+    for (int code : mapping_new) {
+        int old_idx = (code >= 0 && code < ABS_CNT) ? axes[code] : -1;
+        if (old_idx >= 0 && old_idx < (int)m_correction.size()) {
+            corr_new.push_back(m_correction[old_idx]);
+        } else {
+            // Axis was not mapped before, start from the joydev default
+            corr_new.push_back(defaultCorrection(m_absinfo[code >= 0 && code < ABS_CNT ? code : 0]));
+        }
+    }
+
+    m_correction = corr_new;
+}
@@ -0,0 +1,111 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**  
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EVDEV_JOYSTICK_H
+#define EVDEV_JOYSTICK_H
+
+#include <QObject>
+#include <string>
+#include <vector>
+#include <linux/input.h>
+#include <linux/joystick.h>
+
+#include "joystick.h"
+
+/**
+ * Joystick implementation reading the evdev device directly
+ *
+ * Unlike the legacy js interface, evdev keeps the kernel timestamp of every
+ * event and marks the end of each input report with SYN_REPORT. Events are
+ * read in batches and published as one snapshot per report, so the control
+ * loop sees the same frames as the device.
+ *
+ * Axes are numbered in ABS_* code order and buttons in the order of the js
+ * interface, so axis and button numbers match the legacy backend. Axis values
+ * are normalized to -32767..32767 from the EVIOCGABS range of each axis, with
+ * the same fixed-point correction as the kernel joydev driver.
+ */
+class EvdevJoystick : public Joystick
+{
+    Q_OBJECT
+
+public:
+    /**
+     * Constructor
+     * @param device_path Path to the event device, or to a js device whose
+     *                    event device should be used
+     */
+    EvdevJoystick(const std::string& device_path);
+
+    /**
+     * Destructor
+     */
+    ~EvdevJoystick() override;
+
+    void update() override;
+
+    /**
+     * Get a list of joysticks available through evdev
+     * @return List of joystick descriptions, with event device paths
+     */
+    static std::vector<JoystickDescription> getJoysticks();
+
+    /**
+     * Find the event device of a joystick
+     * @param device_path Event device or js device path
+     * @return Event device path, or device_path when it is not a js device
+     */
+    static std::string findEventDevice(const std::string& device_path);
+
+    // Calibration methods
+    std::vector<CalibrationData> getCalibration() override;
+    void setCalibration(const std::vector<CalibrationData>& data) override;
+    void resetCalibration() override;
+    void clearCalibration() override;
+
+    // Mapping methods
+    std::vector<int> getButtonMapping() override;
+    std::vector<int> getAxisMapping() override;
+    void setButtonMapping(const std::vector<int>& mapping) override;
+    void setAxisMapping(const std::vector<int>& mapping) override;
+    void correctCalibration(const std::vector<int>& mapping_old, const std::vector<int>& mapping_new) override;
+
+    std::string getEvdev() const override { return filename; }
+
+private slots:
+    void onSocketActivated(int socket);
+
+private:
+    // Query the capabilities and axis ranges of the open device
+    void initDevice();
+
+    // Apply the correction of an axis to a raw value
+    int convertAxis(int axis, int value) const override;
+
+    // Apply one event to the report being assembled
+    void processEvent(const struct input_event& event);
+
+    std::vector<int> m_axis_mapping;            // ABS_* code of each axis
+    std::vector<int> m_button_mapping;          // KEY_*/BTN_* code of each button
+    struct input_absinfo m_absinfo[ABS_CNT];    // Range of each ABS_* code
+    std::vector<struct js_corr> m_correction;   // Correction of each axis, by axis index
+    std::vector<struct js_corr> m_orig_correction;
+
+    bool m_dropped;                             // Events were lost, skip to the next SYN_REPORT
+};
+
+#endif // EVDEV_JOYSTICK_H
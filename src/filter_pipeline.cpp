@@ -0,0 +1,293 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "filter_pipeline.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Smoothing factor of a first-order low-pass with the given cutoff
+static inline double lowpassAlpha(double cutoff, double dt)
+{
+    return 1.0 - std::exp(-2.0 * M_PI * cutoff * dt);
+}
+
+// Joysticks only report changes, so a repeated value is normally the loop
+// holding the last report. After this long it is taken as a stationary stick.
+static const double PredictionHoldTimeout = 0.05;
+
+// Low-pass cutoff for a device, and the highest one-euro cutoff, as a share of its report rate
+static const double DeviceCutoffShare = 0.25;
+
+// One-euro derivative cutoff as a share of the report rate, averages the speed over several reports
+static const double DeviceDCutoffShare = 0.05;
+
+// Stick speed in normalized units per second at which the one-euro filter is fully open
+static const double FastStickSpeed = 8.0;
+
+// Largest change between two reports in normalized units, larger steps are glitches
+static const double MaxStepPerReport = 0.5;
+
+// Prediction horizons used for a device in seconds, shorter ones are not worth the overshoot
+static const double MinDeviceHorizon = 0.002;
+static const double MaxDeviceHorizon = 0.05;
+
+AxisFilterConfig AxisFilterConfig::forDevice(double reportRate, double jitter)
+{
+    AxisFilterConfig config;
+    if (reportRate <= 0.0) {
+        return config;
+    }
+
+    // Smooth the steps between reports away and open the one-euro filter up
+    // to the same cutoff when the stick moves fast
+    double maxCutoff = reportRate * DeviceCutoffShare;
+    config.smoothingCutoff = std::min(config.smoothingCutoff, maxCutoff);
+    config.smoothingBeta = (maxCutoff - config.smoothingCutoff) / FastStickSpeed;
+    config.smoothingDCutoff = reportRate * DeviceDCutoffShare;
+    config.lowpassCutoff = maxCutoff;
+    config.slewRate = reportRate * MaxStepPerReport;
+
+    // A held report is half an interval old on average, late ones older by the jitter
+    double horizon = 0.5 * std::max(1.0, jitter) / reportRate;
+    config.predictionHorizon = std::min(MaxDeviceHorizon, horizon);
+    if (horizon >= MinDeviceHorizon) {
+        config.predictionMode = ConstantVelocity;
+    }
+    return config;
+}
+
+FilterPipeline::FilterPipeline()
+    : m_stageCount(0),
+      m_dt(0.001),
+      m_lastOutput(0.0)
+{
+}
+
+void FilterPipeline::addStage(StageType type)
+{
+    Stage& stage = m_stages[m_stageCount++];
+    stage.type = type;
+    for (int i = 0; i < 8; i++) stage.param[i] = 0.0;
+    for (int i = 0; i < 5; i++) stage.state[i] = 0.0;
+}
+
+void FilterPipeline::configure(const AxisFilterConfig& config, double sampleRate)
+{
+    m_dt = 1.0 / sampleRate;
+    m_stageCount = 0;
+
+    if (config.deadzone > 0.0 && config.deadzone < 1.0) {
+        addStage(Deadzone);
+        m_stages[m_stageCount - 1].param[0] = config.deadzone;
+    }
+
+    if (config.predictionMode != NoPrediction && config.predictionHorizon > 0.0 &&
+        config.predictionAlpha > 0.0 && config.predictionAlpha <= 1.0) {
+        addStage(Predict);
+        Stage& stage = m_stages[m_stageCount - 1];
+        stage.param[0] = config.predictionAlpha;
+        stage.param[1] = config.predictionBeta;
+
+        // Acceleration gain from the usual alpha-beta-gamma relation
+        stage.param[2] = config.predictionMode == ConstantAcceleration
+                         ? config.predictionBeta * config.predictionBeta / (4.0 * config.predictionAlpha)
+                         : 0.0;
+        stage.param[3] = config.predictionHorizon;
+    }
+
+    if (config.expo > 0.0) {
+        addStage(Expo);
+        m_stages[m_stageCount - 1].param[0] = std::fmin(config.expo, 1.0);
+    }
+
+    if (config.smoothingCutoff > 0.0) {
+        addStage(OneEuro);
+        Stage& stage = m_stages[m_stageCount - 1];
+        stage.param[0] = config.smoothingCutoff;
+        stage.param[1] = config.smoothingBeta;
+        stage.param[2] = config.smoothingDCutoff;
+    }
+
+    // The biquad is only stable below Nyquist, leave it out otherwise
+    if (config.lowpassCutoff > 0.0 && config.lowpassCutoff < 0.45 * sampleRate && config.lowpassQ > 0.0) {
+        addStage(Biquad);
+        Stage& stage = m_stages[m_stageCount - 1];
+        stage.param[5] = config.lowpassCutoff;
+        stage.param[6] = config.lowpassQ;
+        designBiquad(stage, m_dt);
+    }
+
+    if (config.slewRate > 0.0) {
+        addStage(Slew);
+        m_stages[m_stageCount - 1].param[0] = config.slewRate;
+    }
+
+    // Continue from the last output so reconfiguring does not make the mirror jump
+    reset(m_lastOutput);
+}
+
+void FilterPipeline::designBiquad(Stage& stage, double dt)
+{
+    // Trapezoidal state-variable low-pass, the same response as the RBJ
+    // cookbook biquad. Kept below Nyquist for long time steps.
+    double g = std::tan(std::fmin(M_PI * stage.param[5] * dt, 0.45 * M_PI));
+    double k = 1.0 / stage.param[6];
+
+    stage.param[0] = 1.0 / (1.0 + g * (g + k));    // a1
+    stage.param[1] = g * stage.param[0];           // a2
+    stage.param[2] = g * stage.param[1];           // a3
+    stage.param[7] = dt;                           // Time step designed for
+}
+
+void FilterPipeline::reset(double value)
+{
+    for (int i = 0; i < m_stageCount; i++) {
+        Stage& stage = m_stages[i];
+        switch (stage.type) {
+            case Predict:
+                stage.state[0] = value;     // Estimated position
+                stage.state[1] = 0.0;       // Estimated velocity
+                stage.state[2] = 0.0;       // Estimated acceleration
+                stage.state[3] = 0.0;       // Time since the last measurement
+                stage.state[4] = value;     // Last measurement
+                break;
+            case OneEuro:
+                stage.state[0] = value;     // Filtered value
+                stage.state[1] = 0.0;       // Filtered derivative
+                stage.state[2] = value;     // Previous input
+                break;
+            case Biquad:
+                // Steady state for a constant input, the same for every time step
+                stage.state[0] = 0.0;       // Band-pass integrator
+                stage.state[1] = value;     // Low-pass integrator
+                break;
+            case Slew:
+                stage.state[0] = value;
+                break;
+            default:
+                break;
+        }
+    }
+
+    m_lastOutput = value;
+}
+
+double FilterPipeline::process(double x, double dt)
+{
+    if (!(dt > 0.0)) {
+        dt = m_dt;
+    }
+
+    for (int i = 0; i < m_stageCount; i++) {
+        Stage& stage = m_stages[i];
+        switch (stage.type) {
+            case Deadzone: {
+                double dz = stage.param[0];
+                double magnitude = std::fabs(x);
+                x = magnitude < dz ? 0.0 : std::copysign((magnitude - dz) / (1.0 - dz), x);
+                break;
+            }
+
+            case Predict: {
+                double elapsed = stage.state[3] + dt;
+
+                if (x != stage.state[4] || elapsed >= PredictionHoldTimeout) {
+                    // Alpha-beta(-gamma) update over the time since the last measurement
+                    double predicted = stage.state[0] + stage.state[1] * elapsed
+                                       + 0.5 * stage.state[2] * elapsed * elapsed;
+                    double residual = x - predicted;
+
+                    stage.state[0] = predicted + stage.param[0] * residual;
+                    stage.state[1] += stage.state[2] * elapsed + stage.param[1] * residual / elapsed;
+                    stage.state[2] += 2.0 * stage.param[2] * residual / (elapsed * elapsed);
+                    stage.state[3] = 0.0;
+                    stage.state[4] = x;
+                } else {
+                    stage.state[3] = elapsed;
+                }
+
+                // Extrapolate from the last measurement to the horizon
+                double ahead = stage.param[3] + stage.state[3];
+                x = stage.state[0] + stage.state[1] * ahead + 0.5 * stage.state[2] * ahead * ahead;
+                x = std::fmax(-1.0, std::fmin(1.0, x));
+                break;
+            }
+
+            case Expo: {
+                double e = stage.param[0];
+                x = (1.0 - e) * x + e * x * x * x;
+                break;
+            }
+
+            case OneEuro: {
+                // Cutoff rises with the filtered speed, so slow motion is smoothed
+                // and fast motion passes with little lag
+                double dx = (x - stage.state[2]) / dt;
+                stage.state[2] = x;
+                stage.state[1] += (dx - stage.state[1]) * lowpassAlpha(stage.param[2], dt);
+
+                double cutoff = stage.param[0] + stage.param[1] * std::fabs(stage.state[1]);
+                stage.state[0] += (x - stage.state[0]) * lowpassAlpha(cutoff, dt);
+                x = stage.state[0];
+                break;
+            }
+
+            case Biquad: {
+                // The integrator states keep their meaning when the coefficients
+                // change, so redesigning for every time step adds no transient
+                if (dt != stage.param[7]) {
+                    designBiquad(stage, dt);
+                }
+
+                double v3 = x - stage.state[1];
+                double v1 = stage.param[0] * stage.state[0] + stage.param[1] * v3;
+                double v2 = stage.state[1] + stage.param[1] * stage.state[0] + stage.param[2] * v3;
+                stage.state[0] = 2.0 * v1 - stage.state[0];
+                stage.state[1] = 2.0 * v2 - stage.state[1];
+                x = v2;
+                break;
+            }
+
+            case Slew: {
+                double step = x - stage.state[0];
+                double maxStep = stage.param[0] * dt;
+                if (step > maxStep) step = maxStep;
+                if (step < -maxStep) step = -maxStep;
+                stage.state[0] += step;
+                x = stage.state[0];
+                break;
+            }
+        }
+    }
+
+    m_lastOutput = x;
+    return x;
+}
+
+const char* FilterPipeline::stageName(StageType type)
+{
+    switch (type) {
+        case Deadzone: return "Deadzone";
+        case Predict:  return "Prediction";
+        case Expo:     return "Expo";
+        case OneEuro:  return "One-euro";
+        case Biquad:   return "Biquad low-pass";
+        case Slew:     return "Slew limiter";
+    }
+    return "Unknown";
+}
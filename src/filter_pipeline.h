@@ -0,0 +1,164 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FILTER_PIPELINE_H
+#define FILTER_PIPELINE_H
+
+// Motion model of the predictive stage
+enum PredictionMode {
+    NoPrediction,
+    ConstantVelocity,       // Alpha-beta tracker
+    ConstantAcceleration    // Alpha-beta-gamma tracker
+};
+
+/**
+ * Filter settings for one input axis
+ * A stage is left out of the pipeline when its main parameter is zero.
+ */
+struct AxisFilterConfig {
+    double deadzone;            // Axial deadzone (0.0 to 1.0)
+    double expo;                // Expo curve amount (0.0 = linear, 1.0 = cubic)
+    double smoothingCutoff;     // One-euro minimum cutoff in Hz
+    double smoothingBeta;       // One-euro speed coefficient (0 = plain low-pass)
+    double smoothingDCutoff;    // One-euro derivative cutoff in Hz
+    double lowpassCutoff;       // Biquad low-pass cutoff in Hz
+    double lowpassQ;            // Biquad low-pass quality factor
+    double slewRate;            // Maximum change per second (normalized units)
+    PredictionMode predictionMode;  // Motion model used to predict ahead
+    double predictionHorizon;   // How far ahead to predict in seconds
+    double predictionAlpha;     // Position gain of the tracker (0.0 to 1.0)
+    double predictionBeta;      // Velocity gain of the tracker
+
+    // The default matches the fixed 0.3 smoothing of the original 50 Hz loop
+    AxisFilterConfig() :
+        deadzone(0.0),
+        expo(0.0),
+        smoothingCutoff(2.84),
+        smoothingBeta(0.0),
+        smoothingDCutoff(1.0),
+        lowpassCutoff(0.0),
+        lowpassQ(0.7071),
+        slewRate(0.0),
+        predictionMode(NoPrediction),
+        predictionHorizon(0.02),
+        predictionAlpha(0.5),
+        predictionBeta(0.1667)
+    {}
+
+    bool operator==(const AxisFilterConfig& other) const
+    {
+        return deadzone == other.deadzone &&
+               expo == other.expo &&
+               smoothingCutoff == other.smoothingCutoff &&
+               smoothingBeta == other.smoothingBeta &&
+               smoothingDCutoff == other.smoothingDCutoff &&
+               lowpassCutoff == other.lowpassCutoff &&
+               lowpassQ == other.lowpassQ &&
+               slewRate == other.slewRate &&
+               predictionMode == other.predictionMode &&
+               predictionHorizon == other.predictionHorizon &&
+               predictionAlpha == other.predictionAlpha &&
+               predictionBeta == other.predictionBeta;
+    }
+
+    bool operator!=(const AxisFilterConfig& other) const { return !(*this == other); }
+
+    /**
+     * Get the default settings adapted to a measured device
+     * The low-pass, one-euro and slew limits scale with the report rate,
+     * and slow or jittery devices predict over the age of a held report.
+     * @param reportRate Reports per second while the stick moves
+     * @param jitter 99th percentile over median report interval
+     */
+    static AxisFilterConfig forDevice(double reportRate, double jitter);
+};
+
+/**
+ * Chain of filter stages applied to one axis
+ *
+ * The chain is built once from an AxisFilterConfig into a fixed array of
+ * stages, so evaluating a sample never allocates. Stages run in the order
+ * deadzone, prediction, expo, one-euro, biquad low-pass, slew limiter.
+ *
+ * Coefficients are derived from the time step of each sample rather than
+ * a fixed rate, so the response does not change with loop jitter or rate.
+ */
+class FilterPipeline
+{
+public:
+    enum StageType {
+        Deadzone,
+        Predict,
+        Expo,
+        OneEuro,
+        Biquad,
+        Slew
+    };
+
+    static const int MaxStages = 6;
+
+    FilterPipeline();
+
+    /**
+     * Build the stage chain
+     * @param config Filter settings
+     * @param sampleRate Nominal rate at which process() is called in Hz
+     */
+    void configure(const AxisFilterConfig& config, double sampleRate);
+
+    /**
+     * Reset all stage state to a constant input
+     * @param value Value the filters settle on
+     */
+    void reset(double value = 0.0);
+
+    /**
+     * Filter one sample
+     * @param x Input sample
+     * @param dt Time since the previous sample in seconds
+     * @return Filtered sample
+     */
+    double process(double x, double dt);
+
+    /**
+     * Filter one sample taken at the nominal rate
+     * @param x Input sample
+     * @return Filtered sample
+     */
+    double process(double x) { return process(x, m_dt); }
+
+    int getStageCount() const { return m_stageCount; }
+    StageType getStageType(int index) const { return m_stages[index].type; }
+    static const char* stageName(StageType type);
+
+private:
+    struct Stage {
+        StageType type;
+        double param[8];        // Coefficients, meaning depends on type
+        double state[5];        // Filter memory, meaning depends on type
+    };
+
+    void addStage(StageType type);
+    static void designBiquad(Stage& stage, double dt);
+
+    Stage m_stages[MaxStages];
+    int m_stageCount;
+    double m_dt;
+    double m_lastOutput;
+};
+
+#endif // FILTER_PIPELINE_H
@@ -0,0 +1,447 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "input_reactor.h"
+#include "joystick.h"
+#include "utils/input_device_index.h"
+#include "utils/io_uring.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <libudev.h>
+
+InputReactor::InputReactor(QObject* parent)
+    : QThread(parent),
+      m_epollFd(-1),
+      m_wakeupFd(-1),
+      m_udev(nullptr),
+      m_monitor(nullptr),
+      m_cpu(-1),
+      m_backend(Epoll),
+      m_activeBackend(Epoll),
+      m_wakeups(0),
+      m_nextId(FirstSourceId),
+      m_multishot(true)
+{
+    m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (m_epollFd < 0) {
+        qWarning() << "Failed to create input epoll set:" << strerror(errno);
+        return;
+    }
+
+    m_wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_wakeupFd >= 0) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = WakeupId;
+        epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeupFd, &event);
+    } else {
+        qWarning() << "Failed to create input reactor wakeup fd:" << strerror(errno);
+    }
+
+    // Hotplug of any input device, the thread has its own udev context
+    m_udev = udev_new();
+    if (m_udev) {
+        m_monitor = udev_monitor_new_from_netlink(m_udev, "udev");
+    }
+    if (m_monitor) {
+        udev_monitor_filter_add_match_subsystem_devtype(m_monitor, "input", nullptr);
+        if (udev_monitor_enable_receiving(m_monitor) >= 0) {
+            struct epoll_event event;
+            memset(&event, 0, sizeof(event));
+            event.events = EPOLLIN | EPOLLET;
+            event.data.u64 = MonitorId;
+            epoll_ctl(m_epollFd, EPOLL_CTL_ADD, udev_monitor_get_fd(m_monitor), &event);
+        } else {
+            udev_monitor_unref(m_monitor);
+            m_monitor = nullptr;
+        }
+    }
+    if (!m_monitor) {
+        qWarning() << "Input hotplug monitor not available";
+    }
+
+    // The monitor tells when the device index goes stale
+    InputDeviceIndex::instance().setCaching(m_monitor != nullptr);
+}
+
+InputReactor::~InputReactor()
+{
+    stop();
+
+    if (m_monitor) {
+        InputDeviceIndex::instance().setCaching(false);
+        udev_monitor_unref(m_monitor);
+        m_monitor = nullptr;
+    }
+
+    if (m_udev) {
+        udev_unref(m_udev);
+        m_udev = nullptr;
+    }
+
+    if (m_wakeupFd >= 0) {
+        close(m_wakeupFd);
+        m_wakeupFd = -1;
+    }
+
+    if (m_epollFd >= 0) {
+        close(m_epollFd);
+        m_epollFd = -1;
+    }
+}
+
+void InputReactor::setCpu(int cpu)
+{
+    Q_ASSERT(!isRunning());
+    m_cpu = cpu < 0 ? -1 : cpu;
+}
+
+void InputReactor::setBackend(Backend backend)
+{
+    Q_ASSERT(!isRunning());
+    m_backend = backend;
+}
+
+const char* InputReactor::backendName(Backend backend)
+{
+    switch (backend) {
+        case Epoll:       return "epoll";
+        case IoUringPoll: return "io_uring";
+    }
+    return "Unknown";
+}
+
+bool InputReactor::addJoystick(Joystick* joystick)
+{
+    if (!joystick || m_epollFd < 0 || joystick->getFd() < 0) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_sourceMutex);
+
+    Source source;
+    source.joystick = joystick;
+    source.fd = joystick->getFd();
+    uint64_t id = m_nextId++;
+
+    // Edge-triggered: every update() reads the device until it is empty
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN | EPOLLET;
+    event.data.u64 = id;
+    if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, source.fd, &event) < 0) {
+        qWarning() << "Failed to watch joystick:" << joystick->getName() << strerror(errno);
+        return false;
+    }
+
+    joystick->setNotifierEnabled(false);
+    m_sources.insert(id, source);
+
+    // An io_uring thread arms its poll for the new fd on wakeup
+    wake();
+    return true;
+}
+
+void InputReactor::removeJoystick(Joystick* joystick)
+{
+    QMutexLocker locker(&m_sourceMutex);
+
+    for (auto it = m_sources.begin(); it != m_sources.end(); ++it) {
+        if (it.value().joystick == joystick) {
+            dropSource(it.key());
+            joystick->setNotifierEnabled(true);
+            wake();
+            return;
+        }
+    }
+}
+
+void InputReactor::stop()
+{
+    requestInterruption();
+    wake();
+    wait();
+}
+
+void InputReactor::wake()
+{
+    if (m_wakeupFd >= 0) {
+        uint64_t one = 1;
+        ssize_t result = write(m_wakeupFd, &one, sizeof(one));
+        (void)result;
+    }
+}
+
+void InputReactor::run()
+{
+    if (m_epollFd < 0) {
+        return;
+    }
+
+    if (m_cpu >= 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(m_cpu, &cpus);
+
+        int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (result != 0) {
+            qWarning() << "Failed to pin input thread to CPU" << m_cpu << ":" << strerror(result);
+        }
+    }
+
+    if (m_backend == IoUringPoll && runIoUring()) {
+        return;
+    }
+
+    runEpoll();
+}
+
+void InputReactor::runEpoll()
+{
+    m_activeBackend.store(Epoll, std::memory_order_relaxed);
+
+    struct epoll_event events[MaxEvents];
+
+    while (!isInterruptionRequested()) {
+        int count = epoll_wait(m_epollFd, events, MaxEvents, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qWarning() << "Input epoll_wait failed:" << strerror(errno);
+            break;
+        }
+
+        m_wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        for (int i = 0; i < count; i++) {
+            uint64_t id = events[i].data.u64;
+            if (id == WakeupId) {
+                uint64_t value = 0;
+                ssize_t len = read(m_wakeupFd, &value, sizeof(value));
+                (void)len;
+            } else if (id == MonitorId) {
+                readMonitor();
+            } else {
+                dispatch(id, events[i].events);
+            }
+        }
+    }
+}
+
+bool InputReactor::runIoUring()
+{
+    IoUring ring;
+    if (m_wakeupFd < 0 || !ring.initialize(RingEntries)) {
+        qWarning() << "io_uring not available, input thread uses epoll:" << strerror(errno);
+        return false;
+    }
+
+    m_activeBackend.store(IoUringPoll, std::memory_order_relaxed);
+    m_armed.clear();
+
+    bool armWakeup = true;
+    bool armMonitor = m_monitor != nullptr;
+    bool syncSources = true;
+
+    while (!isInterruptionRequested()) {
+        // Re-arm the polls that ended and follow joysticks added or removed
+        if (armWakeup) {
+            armWakeup = !ring.pollAdd(m_wakeupFd, POLLIN, WakeupId, m_multishot);
+        }
+        if (armMonitor) {
+            armMonitor = !ring.pollAdd(udev_monitor_get_fd(m_monitor), POLLIN, MonitorId, m_multishot);
+        }
+        if (syncSources) {
+            syncSources = !armSources(ring);
+        }
+
+        if (ring.submitAndWait(1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            qWarning() << "io_uring_enter failed, input thread falls back to epoll:" << strerror(errno);
+            return false;
+        }
+
+        m_wakeups.fetch_add(1, std::memory_order_relaxed);
+
+        bool failed = false;
+        ring.reap([&](const struct io_uring_cqe& cqe) {
+            uint64_t id = cqe.user_data;
+            bool more = cqe.flags & IORING_CQE_F_MORE;
+
+            if (id == RemoveId) {
+                return;
+            }
+
+            if (cqe.res < 0) {
+                if (cqe.res == -EINVAL && m_multishot) {
+                    // Kernels before 5.13 only have one-shot polls
+                    m_multishot = false;
+                } else if (cqe.res == -ECANCELED) {
+                    // Poll of a removed joystick
+                } else if (id >= FirstSourceId) {
+                    dispatch(id, EPOLLERR);
+                } else {
+                    failed = true;
+                }
+            } else if (id == WakeupId) {
+                uint64_t value = 0;
+                ssize_t len = read(m_wakeupFd, &value, sizeof(value));
+                (void)len;
+                syncSources = true;
+            } else if (id == MonitorId) {
+                readMonitor();
+            } else {
+                // Poll masks share their values with the epoll events
+                dispatch(id, cqe.res);
+            }
+
+            if (!more) {
+                if (id == WakeupId) {
+                    armWakeup = true;
+                } else if (id == MonitorId) {
+                    armMonitor = m_monitor != nullptr;
+                } else {
+                    m_armed.remove(id);
+                    syncSources = true;
+                }
+            }
+        });
+
+        if (failed) {
+            qWarning() << "io_uring poll failed, input thread falls back to epoll";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool InputReactor::armSources(IoUring& ring)
+{
+    QMutexLocker locker(&m_sourceMutex);
+
+    for (auto it = m_sources.begin(); it != m_sources.end(); ++it) {
+        if (m_armed.contains(it.key())) {
+            continue;
+        }
+        if (!ring.pollAdd(it.value().fd, POLLIN, it.key(), m_multishot)) {
+            return false;
+        }
+        m_armed.insert(it.key(), it.value().fd);
+    }
+
+    for (auto it = m_armed.begin(); it != m_armed.end(); ) {
+        if (m_sources.contains(it.key())) {
+            ++it;
+            continue;
+        }
+        if (!ring.pollRemove(it.key(), RemoveId)) {
+            return false;
+        }
+        it = m_armed.erase(it);
+    }
+
+    return true;
+}
+
+void InputReactor::dispatch(uint64_t id, uint32_t events)
+{
+    QString filename;
+    QString error;
+
+    {
+        QMutexLocker locker(&m_sourceMutex);
+
+        auto it = m_sources.find(id);
+        if (it == m_sources.end()) {
+            // Removed after epoll_wait() returned
+            return;
+        }
+
+        Joystick* joystick = it.value().joystick;
+        try {
+            // Pending input is still read when the device hangs up
+            if (events & EPOLLIN) {
+                joystick->update();
+            }
+            if (events & (EPOLLERR | EPOLLHUP)) {
+                error = "Device disconnected";
+            }
+        } catch (const std::exception& e) {
+            error = QString::fromUtf8(e.what());
+        }
+
+        if (error.isEmpty()) {
+            return;
+        }
+
+        filename = QString::fromStdString(joystick->getFilename());
+        dropSource(id);
+    }
+
+    qWarning() << "Lost joystick" << filename << ":" << error;
+    emit joystickLost(filename, error);
+}
+
+void InputReactor::dropSource(uint64_t id)
+{
+    auto it = m_sources.find(id);
+    if (it == m_sources.end()) {
+        return;
+    }
+
+    // Fails harmlessly if the device already went away
+    epoll_ctl(m_epollFd, EPOLL_CTL_DEL, it.value().fd, nullptr);
+    m_sources.erase(it);
+}
+
+void InputReactor::readMonitor()
+{
+    // Edge-triggered, so take every queued uevent
+    struct udev_device* device;
+    while ((device = udev_monitor_receive_device(m_monitor)) != nullptr) {
+        // Any input change, including parents without a node, invalidates the index
+        InputDeviceIndex::instance().invalidate();
+
+        const char* action = udev_device_get_action(device);
+        const char* devnode = udev_device_get_devnode(device);
+
+        if (action && devnode && strncmp(devnode, "/dev/input/", 11) == 0) {
+            if (strcmp(action, "add") == 0) {
+                emit deviceAdded(QString::fromUtf8(devnode));
+            } else if (strcmp(action, "remove") == 0) {
+                emit deviceRemoved(QString::fromUtf8(devnode));
+            }
+        }
+
+        udev_device_unref(device);
+    }
+}
@@ -0,0 +1,182 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INPUT_REACTOR_H
+#define INPUT_REACTOR_H
+
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <atomic>
+#include <stdint.h>
+
+class IoUring;
+class Joystick;
+struct udev;
+struct udev_monitor;
+
+/**
+ * Input thread reading every open joystick, independent of the GUI
+ *
+ * Owns an edge-triggered epoll set with the device fd of each joystick and
+ * a udev monitor for input hotplug. Joysticks added here are read on this
+ * thread instead of through their socket notifier, so they publish their
+ * snapshots and frameChanged() from here. A stalled GUI event loop no
+ * longer delays input.
+ *
+ * The thread waits on either the epoll set or an io_uring with a multishot
+ * poll per fd, whose completions are reaped in batches. Both call
+ * Joystick::update() when a device is readable. Without io_uring the
+ * thread falls back to epoll.
+ *
+ * Joysticks stay owned by the caller. Signals of this class are emitted on
+ * the reactor thread.
+ */
+class InputReactor : public QThread
+{
+    Q_OBJECT
+
+public:
+    // Epoll events handled per wakeup
+    static const int MaxEvents = 16;
+
+    // Submission queue size of the io_uring
+    static const unsigned RingEntries = 64;
+
+    // How the thread waits for input
+    enum Backend {
+        Epoll,          // epoll_wait() on the edge-triggered set
+        IoUringPoll     // Multishot polls on an io_uring
+    };
+
+    explicit InputReactor(QObject* parent = nullptr);
+    ~InputReactor() override;
+
+    /**
+     * Pin the thread to one CPU (only while stopped)
+     * @param cpu CPU number, or -1 to run on any CPU
+     */
+    void setCpu(int cpu);
+    int getCpu() const { return m_cpu; }
+
+    /**
+     * Select how the thread waits for input (only while stopped)
+     * @param backend Requested backend, io_uring falls back to epoll
+     */
+    void setBackend(Backend backend);
+    Backend getBackend() const { return m_backend; }
+
+    /**
+     * Get the backend the running thread actually uses
+     */
+    Backend activeBackend() const { return m_activeBackend.load(std::memory_order_relaxed); }
+
+    static const char* backendName(Backend backend);
+
+    /**
+     * Read a joystick on the reactor thread (GUI thread only)
+     * The socket notifier of the joystick is disabled until it is removed.
+     * @param joystick Joystick to read
+     * @return Whether the device fd could be added to the epoll set
+     */
+    bool addJoystick(Joystick* joystick);
+
+    /**
+     * Stop reading a joystick (GUI thread only)
+     * Once this returns the reactor no longer touches the joystick, so it
+     * may be destroyed.
+     * @param joystick Joystick added before
+     */
+    void removeJoystick(Joystick* joystick);
+
+    /**
+     * Stop the thread and wait for it to exit
+     */
+    void stop();
+
+    /**
+     * Get the number of times the thread woke up with events
+     */
+    uint64_t wakeups() const { return m_wakeups.load(std::memory_order_relaxed); }
+
+signals:
+    /**
+     * Emitted when udev reports a new input device node
+     * @param devnode Device node, e.g. /dev/input/event5
+     */
+    void deviceAdded(const QString& devnode);
+
+    /**
+     * Emitted when udev reports that an input device node went away
+     * @param devnode Device node
+     */
+    void deviceRemoved(const QString& devnode);
+
+    /**
+     * Emitted when reading a joystick fails, it is no longer read afterwards
+     * and should be removed
+     * @param filename Device path of the joystick
+     * @param error Description of the failure
+     */
+    void joystickLost(const QString& filename, const QString& error);
+
+protected:
+    void run() override;
+
+private:
+    void runEpoll();
+    bool runIoUring();
+    bool armSources(IoUring& ring);
+    void wake();
+    void dispatch(uint64_t id, uint32_t events);
+    void dropSource(uint64_t id);
+    void readMonitor();
+
+    // Epoll and io_uring data of the control fds, joysticks are numbered
+    // from FirstSourceId
+    static const uint64_t WakeupId = 0;
+    static const uint64_t MonitorId = 1;
+    static const uint64_t FirstSourceId = 2;
+    static const uint64_t RemoveId = ~0ULL;     // Completions of poll removals
+
+    struct Source {
+        Joystick* joystick;
+        int fd;
+    };
+
+    int m_epollFd;
+    int m_wakeupFd;                 // eventfd signalled by stop() and source changes
+    struct udev* m_udev;
+    struct udev_monitor* m_monitor;
+    int m_cpu;
+    Backend m_backend;
+    std::atomic<Backend> m_activeBackend;
+    std::atomic<uint64_t> m_wakeups;
+
+    // Held while a joystick is read, so removeJoystick() waits for the read.
+    // Ids are never reused, an event for a removed joystick finds nothing.
+    QMutex m_sourceMutex;
+    QMap<uint64_t, Source> m_sources;
+    uint64_t m_nextId;
+
+    // Joysticks with a poll on the io_uring, owned by the reactor thread
+    QMap<uint64_t, int> m_armed;
+    bool m_multishot;           // Cleared when the kernel lacks multishot poll
+};
+
+#endif // INPUT_REACTOR_H
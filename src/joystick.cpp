@@ -33,24 +33,34 @@
 #include <QFile>
 #include <QDir>
 #include <QDebug>
+#include <QMetaMethod>
 
 #include "utils/evdev_helper.h"
+#include "utils/input_device_index.h"
 
 // Protected constructor for derived classes
 Joystick::Joystick()
     : QObject(nullptr),
       fd(-1),
-      notifier(nullptr)
+      snapshot_buffer(std::make_shared<JoystickSnapshotBuffer>()),
+      notifier(nullptr),
+      evdev_generation(0),
+      event_signals(false)
 {
     // Initialize with default values
     // Derived classes should set these appropriately
     axis_count = 0;
     button_count = 0;
+    buildCodeLookup(std::vector<int>(), std::vector<int>());
 }
 
 Joystick::Joystick(const std::string& filename_)
     : QObject(nullptr),
-      filename(filename_)
+      filename(filename_),
+      snapshot_buffer(std::make_shared<JoystickSnapshotBuffer>()),
+      event_clock(EventClock::Jiffies),
+      evdev_generation(0),
+      event_signals(false)
 {
     // Use non-blocking mode for better compatibility with modern Linux systems
     if ((fd = open(filename.c_str(), O_RDONLY | O_NONBLOCK)) < 0)
@@ -83,6 +93,17 @@ Joystick::Joystick(const std::string& filename_)
 
         // Initialize axis state array
         axis_state.resize(axis_count);
+
+        // The kernel numbers js events already, the tables only map the codes behind them
+        try {
+            buildCodeLookup(getAxisMapping(), getButtonMapping());
+        } catch (const std::exception&) {
+            buildCodeLookup(std::vector<int>(), std::vector<int>());
+        }
+
+        current_frame.state.axisCount = std::min(axis_count, (int)JoystickSnapshot::MaxAxes);
+        current_frame.state.buttonCount = std::min(button_count, (int)JoystickSnapshot::MaxButtons);
+        snapshot_buffer->store(current_frame.state);
     }
 
     // Get original calibration data for later reset
@@ -131,11 +152,13 @@ Joystick::onSocketActivated(int socket)
 void
 Joystick::update()
 {
-    struct js_event event;
+    struct js_event events[ReadBatchSize];
+    int64_t timestamp = 0;
+    bool resent = false;
 
-    // We might get multiple events, process all of them
+    // Drain the device with as few reads as possible
     while (true) {
-        ssize_t len = read(fd, &event, sizeof(event));
+        ssize_t len = read(fd, events, sizeof(events));
         
         if (len < 0) {
             // EAGAIN is expected with non-blocking mode when no more events
@@ -151,22 +174,161 @@ Joystick::update()
             // End of file
             break;
         }
-        else if (len == sizeof(event)) {
-            // Process the event
+        else if (len % sizeof(struct js_event) != 0) {
+            throw std::runtime_error("Joystick::update(): incomplete read");
+        }
+
+        size_t count = len / sizeof(struct js_event);
+        for (size_t i = 0; i < count; i++) {
+            const struct js_event& event = events[i];
+
+            // js_event.time is in milliseconds of the kernel tick counter
+            timestamp = event_clock.toMonotonic(static_cast<int64_t>(event.time) * 1000);
+
+            // Joydev resends the whole state after its buffer overflowed
+            if ((event.type & JS_EVENT_INIT) && current_frame.state.frame > 0) {
+                resent = true;
+            }
+
             if (event.type & JS_EVENT_AXIS) {
                 if (event.number < (int)axis_state.size()) {
-                    axis_state[event.number] = event.value;
-                    emit axisChanged(event.number, event.value);
+                    changeAxis(event.number, event.value, timestamp);
                 }
             }
             else if (event.type & JS_EVENT_BUTTON) {
-                emit buttonChanged(event.number, event.value);
+                changeButton(event.number, event.value, timestamp);
             }
         }
-        else {
-            throw std::runtime_error("Joystick::update(): incomplete read");
+
+        // A short read emptied the queue, skip the read that would only return EAGAIN
+        if (count < (size_t)ReadBatchSize) {
+            break;
         }
     }
+
+    if (resent) {
+        report_meter.recordDropped();
+    }
+
+    // The js interface has no report boundaries, everything read at once is one frame
+    if (current_frame.hasChanges()) {
+        publishFrame(timestamp);
+    }
+}
+
+void
+Joystick::setNotifierEnabled(bool enabled)
+{
+    if (notifier) {
+        notifier->setEnabled(enabled);
+    }
+}
+
+void
+Joystick::changeAxis(int id, int value, int64_t timestamp)
+{
+    if (id >= 0 && id < (int)axis_state.size()) {
+        axis_state[id] = value;
+    }
+    current_frame.changeAxis(id, value);
+
+    if (event_signals) {
+        emit axisChanged(id, value, timestamp);
+    }
+}
+
+void
+Joystick::changeButton(int id, bool pressed, int64_t timestamp)
+{
+    current_frame.changeButton(id, pressed);
+
+    if (event_signals) {
+        emit buttonChanged(id, pressed, timestamp);
+    }
+}
+
+void
+Joystick::buildCodeLookup(const std::vector<int>& axis_codes, const std::vector<int>& button_codes)
+{
+    std::fill(abs_index, abs_index + ABS_CNT, -1);
+    std::fill(key_index, key_index + KEY_CNT, -1);
+
+    for (int i = 0; i < (int)axis_codes.size(); i++) {
+        if (axis_codes[i] >= 0 && axis_codes[i] < ABS_CNT) {
+            abs_index[axis_codes[i]] = i;
+        }
+    }
+
+    for (int i = 0; i < (int)button_codes.size(); i++) {
+        if (button_codes[i] >= 0 && button_codes[i] < KEY_CNT) {
+            key_index[button_codes[i]] = i;
+        }
+    }
+}
+
+void
+Joystick::resyncEvdev(const std::vector<int>& axis_codes, const std::vector<int>& button_codes)
+{
+    // The queried state has no event time, it is as of now
+    int64_t timestamp = EventClock::now();
+
+    int axes = std::min((int)axis_codes.size(), (int)axis_state.size());
+    for (int i = 0; i < axes; i++) {
+        int code = axis_codes[i];
+        struct input_absinfo abs;
+        if (code >= 0 && code < ABS_CNT && ioctl(fd, EVIOCGABS(code), &abs) >= 0) {
+            int value = convertAxis(i, abs.value);
+            if (axis_state[i] != value) {
+                changeAxis(i, value, timestamp);
+            }
+        }
+    }
+
+    unsigned long keys[NLONGS(KEY_CNT)] = { 0 };
+    if (ioctl(fd, EVIOCGKEY(sizeof(keys)), keys) >= 0) {
+        for (int i = 0; i < (int)button_codes.size(); i++) {
+            int code = button_codes[i];
+            bool pressed = code >= 0 && code < KEY_CNT && (keys[BIT_WORD(code)] & BIT_MASK(code));
+            if (current_frame.state.button(i) != pressed) {
+                changeButton(i, pressed, timestamp);
+            }
+        }
+    }
+}
+
+void
+Joystick::publishFrame(int64_t timestamp)
+{
+    current_frame.state.timestamp = timestamp;
+    current_frame.state.frame++;
+    snapshot_buffer->store(current_frame.state);
+    report_meter.recordReport(timestamp);
+
+    emit frameChanged(current_frame);
+    current_frame.clearChanges();
+}
+
+void
+Joystick::connectNotify(const QMetaMethod& signal)
+{
+    Q_UNUSED(signal);
+    updateEventSignals();
+}
+
+void
+Joystick::disconnectNotify(const QMetaMethod& signal)
+{
+    Q_UNUSED(signal);
+    updateEventSignals();
+}
+
+void
+Joystick::updateEventSignals()
+{
+    // Emitting a signal nobody listens to still goes through moc, skip it
+    static const QMetaMethod axisSignal = QMetaMethod::fromSignal(&Joystick::axisChanged);
+    static const QMetaMethod buttonSignal = QMetaMethod::fromSignal(&Joystick::buttonChanged);
+    event_signals = isSignalConnected(axisSignal) || isSignalConnected(buttonSignal);
 }
 
 std::vector<JoystickDescription>
@@ -174,142 +336,38 @@ Joystick::getJoysticks()
 {
     std::vector<JoystickDescription> joysticks;
 
-    // Try the joystick devices directly (/dev/input/js*)
-    for(int i = 0; i < 32; ++i)
-    {
-        try
-        {
-            QDir devDir("/dev/input");
-            QString joystickPath = QString("js%1").arg(i);
-            
-            if (devDir.exists(joystickPath))
-            {
-                QString fullPath = devDir.filePath(joystickPath);
-                Joystick joystick(fullPath.toStdString());
+    // Listing needs no device opened, sysfs has the names and capabilities
+    std::vector<InputDeviceInfo> devices = InputDeviceIndex::instance().devices();
 
-                joysticks.push_back(JoystickDescription(joystick.getFilename(),
-                                                       joystick.getName().toStdString(),
-                                                       joystick.getAxisCount(),
-                                                       joystick.getButtonCount()));
-            }
-        }
-        catch(std::exception& err)
+    // The joystick devices (/dev/input/js*)
+    for (const InputDeviceInfo& device : devices)
+    {
+        if (!device.joydev.empty() && access(device.joydev.c_str(), R_OK) == 0)
         {
-            // ok, continue to next device
+            joysticks.push_back(JoystickDescription(device.joydev,
+                                                    device.name,
+                                                    device.axisCount,
+                                                    device.buttonCount,
+                                                    device.hasForceFeedback,
+                                                    device.vendorId,
+                                                    device.productId));
         }
     }
 
-    // If no joysticks found using the traditional method, try alternative detection
+    // Without joydev, fall back to event devices that look like joysticks
     if (joysticks.empty())
     {
-        // Try with evdev directly
-        QDir evdevDir("/dev/input");
-        QStringList filters;
-        filters << "event*";
-        evdevDir.setNameFilters(filters);
-        QStringList eventDevices = evdevDir.entryList();
-        
-        for (const QString& eventDevice : eventDevices)
+        for (const InputDeviceInfo& device : devices)
         {
-            QString fullPath = evdevDir.filePath(eventDevice);
-            int fd = open(fullPath.toStdString().c_str(), O_RDONLY | O_NONBLOCK);
-            
-            if (fd >= 0)
+            if (device.isJoystick() && !device.evdev.empty() && access(device.evdev.c_str(), R_OK) == 0)
             {
-                uint8_t evbit[EV_MAX/8 + 1];
-                memset(evbit, 0, sizeof(evbit));
-                
-                if (ioctl(fd, EVIOCGBIT(0, sizeof(evbit)), evbit) >= 0)
-                {
-                    // Check if this device has joystick-like capabilities
-                    if ((evbit[EV_ABS/8] & (1 << (EV_ABS % 8))) &&
-                        (evbit[EV_KEY/8] & (1 << (EV_KEY % 8))))
-                    {
-                        // Looks like it might be a joystick - get more information
-                        char name[256] = "Unknown";
-                        if (ioctl(fd, EVIOCGNAME(sizeof(name)), name) >= 0)
-                        {
-                            // Get axis and button counts
-                            uint8_t absbit[ABS_MAX/8 + 1];
-                            uint8_t keybit[KEY_MAX/8 + 1];
-                            memset(absbit, 0, sizeof(absbit));
-                            memset(keybit, 0, sizeof(keybit));
-                            
-                            ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbit)), absbit);
-                            ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybit)), keybit);
-                            
-                            // Count axes and buttons
-                            int axis_count = 0;
-                            for (int i = 0; i < ABS_MAX; i++) {
-                                if (absbit[i/8] & (1 << (i % 8))) {
-                                    axis_count++;
-                                }
-                            }
-                            
-                            int button_count = 0;
-                            for (int i = BTN_JOYSTICK; i < KEY_MAX; i++) {
-                                if (keybit[i/8] & (1 << (i % 8))) {
-                                    button_count++;
-                                }
-                            }
-                            
-                            // Check for joystick or gamepad capabilities
-                            bool has_js_buttons = false;
-                            for (int i = BTN_JOYSTICK; i < BTN_DIGI; i++) {
-                                if (keybit[i/8] & (1 << (i % 8))) {
-                                    has_js_buttons = true;
-                                    break;
-                                }
-                            }
-                            
-                            if (!has_js_buttons) {
-                                for (int i = BTN_GAMEPAD; i < BTN_DPAD_UP; i++) {
-                                    if (keybit[i/8] & (1 << (i % 8))) {
-                                        has_js_buttons = true;
-                                        break;
-                                    }
-                                }
-                            }
-                            
-                            if (axis_count > 0 && (button_count > 0 || has_js_buttons)) {
-                                // Transform evdev path to joystick path if possible
-                                QDir jsDevDir("/dev/input");
-                                QString joystickPath;
-                                
-                                // Find corresponding js device by matching device name
-                                for (int i = 0; i < 32; i++) {
-                                    QString jsPath = QString("js%1").arg(i);
-                                    if (jsDevDir.exists(jsPath)) {
-                                        QString fullJsPath = jsDevDir.filePath(jsPath);
-                                        int js_fd = open(fullJsPath.toStdString().c_str(), O_RDONLY | O_NONBLOCK);
-                                        if (js_fd >= 0) {
-                                            char js_name[256] = "";
-                                            if (ioctl(js_fd, JSIOCGNAME(sizeof(js_name)), js_name) >= 0) {
-                                                if (strcmp(name, js_name) == 0) {
-                                                    joystickPath = fullJsPath;
-                                                    close(js_fd);
-                                                    break;
-                                                }
-                                            }
-                                            close(js_fd);
-                                        }
-                                    }
-                                }
-                                
-                                // If no matching js device found, use the event device
-                                if (joystickPath.isEmpty()) {
-                                    joystickPath = fullPath;
-                                }
-                                
-                                joysticks.push_back(JoystickDescription(joystickPath.toStdString(),
-                                                                      name,
-                                                                      axis_count,
-                                                                      button_count));
-                            }
-                        }
-                    }
-                }
-                close(fd);
+                joysticks.push_back(JoystickDescription(device.evdev,
+                                                        device.name,
+                                                        device.axisCount,
+                                                        device.buttonCount,
+                                                        device.hasForceFeedback,
+                                                        device.vendorId,
+                                                        device.productId));
             }
         }
     }
@@ -404,6 +462,24 @@ struct js_corr cal2corr(const Joystick::CalibrationData& data)
     return corr;
 }
 
+int applyCorrection(const struct js_corr& corr, int value)
+{
+    int64_t v = value;
+
+    if (corr.type == JS_CORR_BROKEN) {
+        // The slopes are scaled by 2^14, 64-bit products cannot overflow
+        if (v <= corr.coef[0]) {
+            v = (corr.coef[2] * (v - corr.coef[0])) >> 14;
+        } else if (v < corr.coef[1]) {
+            v = 0;
+        } else {
+            v = (corr.coef[3] * (v - corr.coef[1])) >> 14;
+        }
+    }
+
+    return static_cast<int>(std::max<int64_t>(-32767, std::min<int64_t>(32767, v)));
+}
+
 void
 Joystick::setCalibration(const std::vector<CalibrationData>& data)
 {
@@ -494,6 +570,8 @@ Joystick::setButtonMapping(const std::vector<int>& mapping)
         QString errorMsg = QString("%1: %2").arg(QString::fromStdString(filename)).arg(strerror(errno));
         throw std::runtime_error(errorMsg.toStdString());
     }
+
+    buildCodeLookup(getAxisMapping(), mapping);
 }
 
 int
@@ -519,6 +597,8 @@ Joystick::setAxisMapping(const std::vector<int>& mapping)
         QString errorMsg = QString("%1: %2").arg(QString::fromStdString(filename)).arg(strerror(errno));
         throw std::runtime_error(errorMsg.toStdString());
     }
+
+    buildCodeLookup(mapping, getButtonMapping());
 }
 
 void
@@ -543,36 +623,28 @@ Joystick::correctCalibration(const std::vector<int>& mapping_old, const std::vec
 std::string
 Joystick::getEvdev() const
 {
-    // See /usr/share/doc/linux-doc-2.6.28/devices.txt.gz
-    for(int i = 0; i < 32; ++i)
+    InputDeviceIndex& index = InputDeviceIndex::instance();
+
+    // The event node only changes when a device is replugged, which invalidates the index
+    uint64_t generation = index.generation();
+    if (!evdev_path.empty() && index.caching() && generation == evdev_generation)
     {
-        QString eventPath = QString("/dev/input/event%1").arg(i);
+        return evdev_path;
+    }
 
-        int evdev_fd;
-        if ((evdev_fd = open(eventPath.toStdString().c_str(), O_RDONLY)) < 0)
-        {
-            // ignore
-        }
-        else
-        {
-            char evdev_name[256];
-            if (ioctl(evdev_fd, EVIOCGNAME(sizeof(evdev_name)), evdev_name) < 0)
-            {
-                std::cout << eventPath.toStdString() << ": " << strerror(errno) << std::endl;
-            }
-            else
-            {
-                if (orig_name == evdev_name)
-                {
-                    // Found a device that matches, so return it
-                    close(evdev_fd);
-                    return eventPath.toStdString();
-                }
-            }
+    // The open device tells identical sticks apart, the path covers a closed one
+    InputDeviceInfo info;
+    struct stat st;
+    bool found = (fd >= 0 && fstat(fd, &st) == 0 && S_ISCHR(st.st_mode) &&
+                  index.findByNumber(st.st_rdev, info)) ||
+                 index.findByNode(filename, info);
 
-            close(evdev_fd);
-        }
+    if (!found || info.evdev.empty())
+    {
+        throw std::runtime_error("couldn't find evdev for " + filename);
     }
 
-    throw std::runtime_error("couldn't find evdev for " + filename);
+    evdev_path = info.evdev;
+    evdev_generation = generation;
+    return evdev_path;
 }
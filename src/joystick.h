@@ -21,10 +21,14 @@
 #include <QObject>
 #include <QSocketNotifier>
 #include <QString>
+#include <memory>
 #include <vector>
 #include <linux/joystick.h>
 
 #include "joystick_description.h"
+#include "joystick_state.h"
+#include "utils/event_clock.h"
+#include "utils/report_meter.h"
 
 /**
  * Class that represents a joystick device and provides access to its state
@@ -34,6 +38,9 @@ class Joystick : public QObject
     Q_OBJECT
 
 public:
+    // Events taken from the device per read() call
+    static const int ReadBatchSize = 64;
+
     /**
      * Structure containing calibration data for a joystick axis
      */
@@ -58,8 +65,21 @@ protected:
     std::vector<int> axis_state;  // Current state of each axis
     std::vector<CalibrationData> orig_calibration_data;  // Original calibration data
 
+    JoystickFrame current_frame;        // Report being assembled, including the button bitset
+
+    // Direct-indexed lookup from event codes to axis/button numbers, -1 if unmapped
+    // Only built by the backends that read event device codes.
+    int16_t abs_index[ABS_CNT];
+    int16_t key_index[KEY_CNT];
+    std::shared_ptr<JoystickSnapshotBuffer> snapshot_buffer;  // Last published report
+    ReportMeter report_meter;           // Rate and timing of the published reports
+    EventClock event_clock;             // Converts the kernel event times to CLOCK_MONOTONIC
+
     QSocketNotifier* notifier;  // Socket notifier for monitoring joystick events
 
+    mutable std::string evdev_path;     // Cached result of getEvdev()
+    mutable uint64_t evdev_generation;  // Device index generation it was resolved in
+
 public:
     /**
      * Constructor
@@ -79,10 +99,18 @@ public:
     virtual int getFd() const { return fd; }
 
     /**
-     * Update joystick state by reading events from the device
+     * Update joystick state by reading all pending events from the device,
+     * up to ReadBatchSize events per read() call
      */
     virtual void update();
 
+    /**
+     * Enable or disable reading the device from the event loop of the
+     * joystick's thread. Disabled while another thread calls update().
+     * @param enabled Whether the socket notifier is active
+     */
+    void setNotifierEnabled(bool enabled);
+
     /**
      * Get the path to the joystick device
      * @return Device path
@@ -114,6 +142,26 @@ public:
      */
     virtual int getAxisState(int id);
 
+    /**
+     * Get a consistent copy of the last published report
+     * Safe to call from any thread.
+     * @return Snapshot of all axes and buttons
+     */
+    JoystickSnapshot getSnapshot() const { return snapshot_buffer->load(); }
+
+    /**
+     * Get the buffer the joystick publishes its reports to
+     * The buffer outlives the joystick, so consumer threads may keep it.
+     * @return Shared snapshot buffer
+     */
+    JoystickSnapshotSource getSnapshotSource() const { return snapshot_buffer; }
+
+    /**
+     * Get the report rate, interval histogram and lost reports of the device
+     * Updated by the thread reading the joystick, readable from any thread.
+     */
+    const ReportMeter& getReportMeter() const { return report_meter; }
+
     /**
      * Get a list of available joysticks
      * @return List of joystick descriptions
@@ -175,6 +223,8 @@ public:
 
     /**
      * Get the evdev device path for this joystick
+     * Resolved through sysfs from the open device and cached until the
+     * input devices change.
      * @return Evdev device path
      */
     virtual std::string getEvdev() const;
@@ -184,21 +234,83 @@ signals:
      * Signal emitted when an axis value changes
      * @param number Axis number
      * @param value New axis value (-32767 to 32767)
+     * @param timestamp Kernel time of the event, CLOCK_MONOTONIC microseconds
      */
-    void axisChanged(int number, int value);
+    void axisChanged(int number, int value, qint64 timestamp);
     
     /**
      * Signal emitted when a button state changes
      * @param number Button number
      * @param value New button state (true = pressed, false = released)
+     * @param timestamp Kernel time of the event, CLOCK_MONOTONIC microseconds
      */
-    void buttonChanged(int number, bool value);
+    void buttonChanged(int number, bool value, qint64 timestamp);
+
+    /**
+     * Signal emitted once per input report, after its axisChanged and
+     * buttonChanged signals, with the whole device state and what changed.
+     * The snapshot buffer already holds the report when this is emitted.
+     * @param frame The completed report, only valid during the call
+     */
+    void frameChanged(const JoystickFrame& frame);
 
 protected:
     /**
      * Protected constructor for derived classes
      */
     Joystick();
+
+    /**
+     * Record an axis change in the report being assembled
+     * axisChanged() is only emitted while a receiver is connected.
+     * @param id Axis number
+     * @param value New axis value (-32767 to 32767)
+     * @param timestamp Kernel time of the event, CLOCK_MONOTONIC microseconds
+     */
+    void changeAxis(int id, int value, int64_t timestamp);
+
+    /**
+     * Record a button change in the report being assembled
+     * buttonChanged() is only emitted while a receiver is connected.
+     * @param id Button number
+     * @param pressed New button state
+     * @param timestamp Kernel time of the event, CLOCK_MONOTONIC microseconds
+     */
+    void changeButton(int id, bool pressed, int64_t timestamp);
+
+    /**
+     * Rebuild abs_index and key_index
+     * @param axis_codes ABS_* code of each axis
+     * @param button_codes Key code of each button
+     */
+    void buildCodeLookup(const std::vector<int>& axis_codes, const std::vector<int>& button_codes);
+
+    /**
+     * Read the current state of all axes and buttons from the event device
+     * on fd, e.g. after SYN_DROPPED, and record what changed in the report
+     * being assembled
+     * @param axis_codes ABS_* code of each axis
+     * @param button_codes Key code of each button
+     */
+    void resyncEvdev(const std::vector<int>& axis_codes, const std::vector<int>& button_codes);
+
+    /**
+     * Convert a raw event device value of an axis to its reported value
+     * @param axis Axis number
+     * @param value Raw ABS_* value
+     * @return Axis value (-32767 to 32767)
+     */
+    virtual int convertAxis(int axis, int value) const { Q_UNUSED(axis); return value; }
+
+    /**
+     * Publish the report being assembled to the snapshot buffer, emit
+     * frameChanged() and start the next report
+     * @param timestamp Kernel time of the report, CLOCK_MONOTONIC microseconds
+     */
+    void publishFrame(int64_t timestamp);
+
+    void connectNotify(const QMetaMethod& signal) override;
+    void disconnectNotify(const QMetaMethod& signal) override;
     
 private slots:
     /**
@@ -208,8 +320,26 @@ private slots:
     void onSocketActivated(int socket);
 
 private:
+    // Whether axisChanged or buttonChanged have a receiver
+    void updateEventSignals();
+
+    bool event_signals;
+
     Joystick(const Joystick&) = delete;
     Joystick& operator=(const Joystick&) = delete;
 };
 
+// Conversion between calibration data and the kernel joydev correction
+Joystick::CalibrationData corr2cal(const struct js_corr& corr);
+struct js_corr cal2corr(const Joystick::CalibrationData& data);
+
+/**
+ * Apply a joydev correction to a raw axis value in software
+ * Uses the fixed-point slopes of the correction as the kernel does.
+ * @param corr Correction of the axis
+ * @param value Raw axis value
+ * @return Corrected value (-32767 to 32767)
+ */
+int applyCorrection(const struct js_corr& corr, int value);
+
 #endif // JOYSTICK_H
@@ -22,6 +22,7 @@
 #include <QProcessEnvironment>
 
 #include "joystick.h"
+#include "evdev_joystick.h"
 #include "libinput_joystick.h"
 #include "utils/libinput_helper.h"
 
@@ -113,6 +114,19 @@ std::vector<JoystickDescription> JoystickFactory::getJoysticks(JoystickBackend b
             }
         }
             
+        case JoystickBackend::EVDEV:
+            if (backend == JoystickBackend::EVDEV) {
+                // Get devices by reading the event devices directly
+                result = EvdevJoystick::getJoysticks();
+
+                if (result.empty()) {
+                    qDebug() << "No devices found with evdev, falling back to legacy";
+                    backend = JoystickBackend::LEGACY;
+                } else {
+                    break;
+                }
+            }
+
         case JoystickBackend::LEGACY:
         default:
             // Get devices using the traditional method
@@ -148,7 +162,18 @@ std::unique_ptr<Joystick> JoystickFactory::createJoystick(const std::string& dev
                     qWarning() << "Failed to create LibinputJoystick, falling back to legacy:" << e.what();
                     backend = JoystickBackend::LEGACY;
                 }
-                
+
+            case JoystickBackend::EVDEV:
+                if (backend == JoystickBackend::EVDEV) {
+                    try {
+                        return std::unique_ptr<Joystick>(new EvdevJoystick(device_path));
+                    } catch (const std::exception& e) {
+                        // If evdev fails, fall back to legacy
+                        qWarning() << "Failed to create EvdevJoystick, falling back to legacy:" << e.what();
+                        backend = JoystickBackend::LEGACY;
+                    }
+                }
+
             case JoystickBackend::LEGACY:
             default:
                 // Create a traditional joystick
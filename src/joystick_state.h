@@ -0,0 +1,145 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef JOYSTICK_STATE_H
+#define JOYSTICK_STATE_H
+
+#include <memory>
+#include <stdint.h>
+
+#include "utils/seqlock.h"
+
+/**
+ * Complete state of a joystick after one input report
+ *
+ * Plain data so it can be published through a SeqLock and copied by any
+ * consumer thread without locking.
+ */
+struct JoystickSnapshot {
+    static const int MaxAxes = 32;
+    static const int MaxButtons = 512;
+
+    int16_t axes[MaxAxes];                  // Axis values (-32767 to 32767)
+    uint64_t buttons[MaxButtons / 64];      // Button bitmask
+    uint16_t axisCount;                     // Number of valid axes
+    uint16_t buttonCount;                   // Number of valid buttons
+    int64_t timestamp;                      // Kernel time of the report, CLOCK_MONOTONIC microseconds
+    uint64_t frame;                         // Number of reports published so far
+
+    JoystickSnapshot() :
+        axes(),
+        buttons(),
+        axisCount(0),
+        buttonCount(0),
+        timestamp(0),
+        frame(0)
+    {}
+
+    int axis(int id) const
+    {
+        return (id >= 0 && id < axisCount) ? axes[id] : 0;
+    }
+
+    void setAxis(int id, int value)
+    {
+        if (id >= 0 && id < MaxAxes) {
+            axes[id] = static_cast<int16_t>(value);
+        }
+    }
+
+    bool button(int id) const
+    {
+        return (id >= 0 && id < buttonCount) && (buttons[id / 64] >> (id % 64)) & 1;
+    }
+
+    void setButton(int id, bool pressed)
+    {
+        if (id >= 0 && id < MaxButtons) {
+            if (pressed) {
+                buttons[id / 64] |= (1ULL << (id % 64));
+            } else {
+                buttons[id / 64] &= ~(1ULL << (id % 64));
+            }
+        }
+    }
+};
+
+/**
+ * One input report: the whole device state after it, and which axes and
+ * buttons the report changed
+ */
+struct JoystickFrame {
+    JoystickSnapshot state;                                     // All axes and buttons after the report
+    uint32_t changedAxes;                                       // Bit per axis changed by the report
+    uint64_t changedButtons[JoystickSnapshot::MaxButtons / 64]; // Bit per button changed by the report
+
+    JoystickFrame() :
+        changedAxes(0),
+        changedButtons()
+    {}
+
+    bool axisChanged(int id) const
+    {
+        return (id >= 0 && id < JoystickSnapshot::MaxAxes) && (changedAxes >> id) & 1;
+    }
+
+    bool buttonChanged(int id) const
+    {
+        return (id >= 0 && id < JoystickSnapshot::MaxButtons) && (changedButtons[id / 64] >> (id % 64)) & 1;
+    }
+
+    bool hasChanges() const
+    {
+        uint64_t any = changedAxes;
+        for (int i = 0; i < JoystickSnapshot::MaxButtons / 64; i++) {
+            any |= changedButtons[i];
+        }
+        return any != 0;
+    }
+
+    void changeAxis(int id, int value)
+    {
+        if (id >= 0 && id < JoystickSnapshot::MaxAxes) {
+            state.setAxis(id, value);
+            changedAxes |= (1U << id);
+        }
+    }
+
+    void changeButton(int id, bool pressed)
+    {
+        if (id >= 0 && id < JoystickSnapshot::MaxButtons) {
+            state.setButton(id, pressed);
+            changedButtons[id / 64] |= (1ULL << (id % 64));
+        }
+    }
+
+    void clearChanges()
+    {
+        changedAxes = 0;
+        for (int i = 0; i < JoystickSnapshot::MaxButtons / 64; i++) {
+            changedButtons[i] = 0;
+        }
+    }
+};
+
+static_assert(JoystickSnapshot::MaxAxes <= 32, "changedAxes has one bit per axis");
+
+// Wait-free for the publishing input thread, lock-free for readers
+typedef SeqLock<JoystickSnapshot> JoystickSnapshotBuffer;
+typedef std::shared_ptr<const JoystickSnapshotBuffer> JoystickSnapshotSource;
+
+#endif // JOYSTICK_STATE_H
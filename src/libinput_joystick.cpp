@@ -23,7 +23,9 @@
 #include <unistd.h>
 #include <linux/input.h>
 #include <libudev.h>
+#include <errno.h>
 #include <math.h>
+#include <string.h>
 #include <algorithm>
 #include <stdexcept>
 #include <iostream>
@@ -71,11 +73,9 @@ static const struct libinput_interface joystick_interface = {
 
 LibinputJoystick::LibinputJoystick(const std::string& device_path)
     : Joystick(), // Call the base class constructor
-      m_udev(nullptr),
-      m_libinput(nullptr),
       m_device(nullptr),
-      m_notifier(nullptr),
-      m_syspath("")
+      m_syspath(""),
+      m_dropped(false)
 {
     // Initialize base class member
     filename = device_path;
@@ -87,47 +87,34 @@ LibinputJoystick::LibinputJoystick(const std::string& device_path)
     // Create and store original calibration data
     orig_calibration_data = getCalibration();
 
-    // Set up socket notifier for event processing
-    int fd = libinput_get_fd(m_libinput);
-    m_notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
-    connect(m_notifier, &QSocketNotifier::activated, this, &LibinputJoystick::onSocketActivated, 
-            Qt::DirectConnection);
-    m_notifier->setEnabled(true);
+    // Set up socket notifier for the axes and buttons, libinput device events
+    // arrive through the shared context
+    if (fd >= 0) {
+        notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &LibinputJoystick::onSocketActivated,
+                Qt::DirectConnection);
+        notifier->setEnabled(true);
+    }
     
     qDebug() << "LibinputJoystick initialized:" << name << "with" << axis_count << "axes and" << button_count << "buttons";
 }
 
 LibinputJoystick::~LibinputJoystick()
 {
-    // Clean up resources
-    if (m_notifier) {
-        m_notifier->setEnabled(false);
-        delete m_notifier;
-        m_notifier = nullptr;
-    }
-
+    // Clean up resources, the base class closes the event device
     if (m_device) {
-        libinput_device_unref(m_device);
+        LibinputHelper::instance()->removeDevice(m_device);
         m_device = nullptr;
     }
-
-    if (m_libinput) {
-        libinput_unref(m_libinput);
-        m_libinput = nullptr;
-    }
-
-    if (m_udev) {
-        udev_unref(m_udev);
-        m_udev = nullptr;
-    }
 }
 
 bool LibinputJoystick::initDevice()
 {
-    // Initialize udev
-    m_udev = udev_new();
-    if (!m_udev) {
-        qWarning() << "Failed to initialize udev";
+    memset(m_axis_range, 0, sizeof(m_axis_range));
+
+    // All joysticks share the udev handle and libinput context of the helper
+    LibinputHelper* helper = LibinputHelper::instance();
+    if (!helper->initialize()) {
         return false;
     }
 
@@ -137,11 +124,9 @@ bool LibinputJoystick::initDevice()
     // For syspath, find the corresponding device node
     std::string device_node;
     if (is_syspath) {
-        struct udev_device* dev = udev_device_new_from_syspath(m_udev, filename.c_str());
+        struct udev_device* dev = udev_device_new_from_syspath(helper->udev(), filename.c_str());
         if (!dev) {
             qWarning() << "Failed to find device for syspath:" << QString::fromStdString(filename);
-            udev_unref(m_udev);
-            m_udev = nullptr;
             return false;
         }
         
@@ -154,8 +139,6 @@ bool LibinputJoystick::initDevice()
         
         if (device_node.empty()) {
             qWarning() << "No device node found for syspath:" << QString::fromStdString(filename);
-            udev_unref(m_udev);
-            m_udev = nullptr;
             return false;
         }
         
@@ -164,23 +147,10 @@ bool LibinputJoystick::initDevice()
         device_node = filename;
     }
     
-    // Create a libinput context for this device
-    m_libinput = libinput_path_create_context(&joystick_interface, nullptr);
-    if (!m_libinput) {
-        qWarning() << "Failed to create libinput context";
-        udev_unref(m_udev);
-        m_udev = nullptr;
-        return false;
-    }
-    
-    // Add the device to the context
-    m_device = libinput_path_add_device(m_libinput, device_node.c_str());
+    // Add the device to the shared context, events for it come back through libinputEvent()
+    m_device = helper->addDevice(QString::fromStdString(device_node), this);
     if (!m_device) {
         qWarning() << "Failed to add device to libinput context:" << QString::fromStdString(device_node);
-        libinput_unref(m_libinput);
-        m_libinput = nullptr;
-        udev_unref(m_udev);
-        m_udev = nullptr;
         return false;
     }
     
@@ -208,19 +178,33 @@ bool LibinputJoystick::initDevice()
             // Use the actual device node as the filename
             filename = devnode;
             
-            // Now count axes and buttons
-            int fd = open(devnode, O_RDONLY | O_NONBLOCK);
-            if (fd >= 0) {
+            // libinput does not report joystick axes, read them from the event
+            // device opened through the same permission hook libinput uses
+            fd = joystick_open_restricted(devnode, O_RDONLY | O_NONBLOCK, nullptr);
+            if (fd < 0) {
+                qWarning() << "Failed to open event device:" << devnode << strerror(-fd);
+                fd = -1;
+            } else {
+                // Stamp events on the clock the control loop uses
+                if (!event_clock.selectMonotonic(fd)) {
+                    qWarning() << "Event times of" << devnode << "stay on CLOCK_REALTIME:" << strerror(errno);
+                }
+
                 unsigned long evbit[NLONGS(EV_CNT)] = { 0 };
                 unsigned long keybit[NLONGS(KEY_CNT)] = { 0 };
                 unsigned long absbit[NLONGS(ABS_CNT)] = { 0 };
                 
                 if (ioctl(fd, EVIOCGBIT(0, sizeof(evbit)), evbit) >= 0) {
-                    // Count absolute axes
+                    // Count absolute axes and build their scaling table
                     if (evbit[BIT_WORD(EV_ABS)] & BIT_MASK(EV_ABS)) {
                         ioctl(fd, EVIOCGBIT(EV_ABS, sizeof(absbit)), absbit);
                         for (int i = 0; i < ABS_CNT; i++) {
                             if (absbit[BIT_WORD(i)] & BIT_MASK(i)) {
+                                struct input_absinfo absinfo;
+                                if (ioctl(fd, EVIOCGABS(i), &absinfo) < 0) {
+                                    continue;
+                                }
+                                setAxisRange(i, absinfo);
                                 axis_count++;
                                 // Store the axis mapping
                                 m_axis_mapping.push_back(i);
@@ -232,7 +216,7 @@ bool LibinputJoystick::initDevice()
                     if (evbit[BIT_WORD(EV_KEY)] & BIT_MASK(EV_KEY)) {
                         ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keybit)), keybit);
                         
-                        // Count joystick buttons
+                        // Count joystick and gamepad buttons
                         for (int btn = BTN_JOYSTICK; btn < BTN_DIGI; btn++) {
                             if (keybit[BIT_WORD(btn)] & BIT_MASK(btn)) {
                                 button_count++;
@@ -240,18 +224,8 @@ bool LibinputJoystick::initDevice()
                                 m_button_mapping.push_back(btn);
                             }
                         }
-                        
-                        // Count gamepad buttons
-                        for (int btn = BTN_GAMEPAD; btn < BTN_DPAD_UP; btn++) {
-                            if (keybit[BIT_WORD(btn)] & BIT_MASK(btn)) {
-                                button_count++;
-                                // Store the button mapping
-                                m_button_mapping.push_back(btn);
-                            }
-                        }
                     }
                 }
-                close(fd);
             }
         }
         
@@ -260,182 +234,171 @@ bool LibinputJoystick::initDevice()
     
     // Initialize state vectors
     axis_state.resize(axis_count, 0);
-    m_button_state.resize(button_count, false);
+    buildCodeLookup(m_axis_mapping, m_button_mapping);
+
+    current_frame.state.axisCount = std::min(axis_count, (int)JoystickSnapshot::MaxAxes);
+    current_frame.state.buttonCount = std::min(button_count, (int)JoystickSnapshot::MaxButtons);
     
-    // Initialize calibration data
-    std::vector<CalibrationData> cal_data;
-    cal_data.resize(axis_count);
+    // The axes are already scaled from their absinfo range, start uncalibrated
+    struct js_corr corr;
+    memset(&corr, 0, sizeof(corr));
+    corr.type = JS_CORR_NONE;
+    m_correction.assign(axis_count, corr);
+    m_orig_correction = m_correction;
+
+    // Start from the current position of every axis
     for (int i = 0; i < axis_count; i++) {
-        cal_data[i].calibrate = false;
-        cal_data[i].invert = false;
-        cal_data[i].center_min = 0;
-        cal_data[i].center_max = 0;
-        cal_data[i].range_min = -32767;
-        cal_data[i].range_max = 32767;
+        struct input_absinfo absinfo;
+        if (fd >= 0 && ioctl(fd, EVIOCGABS(m_axis_mapping[i]), &absinfo) >= 0) {
+            axis_state[i] = applyCalibration(i, normalizeAxis(m_axis_mapping[i], absinfo.value));
+            current_frame.state.setAxis(i, axis_state[i]);
+        }
     }
+    snapshot_buffer->store(current_frame.state);
     
     return true;
 }
 
-int LibinputJoystick::getFd() const
+void LibinputJoystick::setAxisRange(int code, const struct input_absinfo& absinfo)
 {
-    return m_libinput ? libinput_get_fd(m_libinput) : -1;
+    // 16.16 fixed-point slope from the device range to -32767..32767
+    AxisRange& range = m_axis_range[code];
+    range.minimum = absinfo.minimum;
+    range.slope = absinfo.maximum > absinfo.minimum
+                  ? (static_cast<int64_t>(65534) << 16) / (static_cast<int64_t>(absinfo.maximum) - absinfo.minimum)
+                  : 0;
+}
+
+int LibinputJoystick::normalizeAxis(int code, int value) const
+{
+    const AxisRange& range = m_axis_range[code];
+    int64_t scaled = ((static_cast<int64_t>(value) - range.minimum) * range.slope >> 16) - 32767;
+    return static_cast<int>(std::max<int64_t>(-32767, std::min<int64_t>(32767, scaled)));
 }
 
 void LibinputJoystick::onSocketActivated(int socket)
 {
-    if (socket == getFd()) {
+    if (socket == fd) {
         update();
     }
 }
 
 void LibinputJoystick::update()
 {
-    if (!m_libinput)
+    readEvents();
+}
+
+void LibinputJoystick::libinputEvent(libinput_event* event)
+{
+    // Only the pointer emulation of the device shows up here, the event
+    // device has the same input. The device itself may go away.
+    if (libinput_event_get_type(event) == LIBINPUT_EVENT_DEVICE_REMOVED) {
+        qWarning() << "Joystick removed:" << name;
+        m_device = nullptr;
+    }
+}
+
+quint64 LibinputJoystick::getLibinputEventCount() const
+{
+    return m_device ? LibinputHelper::instance()->eventCount(m_device) : 0;
+}
+
+void LibinputJoystick::readEvents()
+{
+    if (fd < 0)
         return;
-        
-    // Process events
-    libinput_dispatch(m_libinput);
-    
-    struct libinput_event *event;
-    while ((event = libinput_get_event(m_libinput)) != nullptr) {
-        enum libinput_event_type type = libinput_event_get_type(event);
-        
-        switch (type) {
-            case LIBINPUT_EVENT_POINTER_MOTION:
-                // Handle relative motion (not used for joysticks)
+
+    struct input_event events[ReadBatchSize];
+
+    while (true) {
+        ssize_t len = read(fd, events, sizeof(events));
+
+        if (len < 0) {
+            // EAGAIN is expected with non-blocking mode when no more events
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
                 break;
-                
-            case LIBINPUT_EVENT_POINTER_MOTION_ABSOLUTE: {
-                // Handle absolute motion events (axes)
-                struct libinput_event_pointer *pointer_event = 
-                    libinput_event_get_pointer_event(event);
-                    
-                // Convert normalized coordinates to our range
-                double x = libinput_event_pointer_get_absolute_x_transformed(
-                    pointer_event, 65535) - 32767;
-                double y = libinput_event_pointer_get_absolute_y_transformed(
-                    pointer_event, 65535) - 32767;
-                    
-                // Update X axis if we have one
-                if (axis_count > 0) {
-                    int old_value = axis_state[0];
-                    int new_value = applyCalibration(0, static_cast<int>(x));
-                    axis_state[0] = new_value;
-                    if (old_value != new_value) {
-                        emit axisChanged(0, new_value);
-                    }
+            }
+
+            QString errorMsg = QString("%1: %2").arg(QString::fromStdString(filename)).arg(strerror(errno));
+            qWarning() << "Error reading from joystick:" << errorMsg;
+            throw std::runtime_error(errorMsg.toStdString());
+        }
+        else if (len == 0 || len % sizeof(struct input_event) != 0) {
+            break;
+        }
+
+        size_t count = len / sizeof(struct input_event);
+        for (size_t i = 0; i < count; i++) {
+            processEvent(events[i]);
+        }
+
+        // A short read emptied the queue, skip the read that would only return EAGAIN
+        if (count < static_cast<size_t>(ReadBatchSize)) {
+            break;
+        }
+    }
+}
+
+void LibinputJoystick::processEvent(const struct input_event& event)
+{
+    int64_t timestamp = event_clock.toMonotonic(static_cast<int64_t>(event.input_event_sec) * 1000000 +
+                                                event.input_event_usec);
+
+    switch (event.type) {
+        case EV_SYN:
+            if (event.code == SYN_DROPPED) {
+                // Events were lost, ignore the rest of this report
+                m_dropped = true;
+                report_meter.recordDropped();
+            } else if (event.code == SYN_REPORT) {
+                // The events of the dropped report are lost, read the state instead
+                if (m_dropped) {
+                    m_dropped = false;
+                    resyncEvdev(m_axis_mapping, m_button_mapping);
                 }
-                
-                // Update Y axis if we have one
-                if (axis_count > 1) {
-                    int old_value = axis_state[1];
-                    int new_value = applyCalibration(1, static_cast<int>(y));
-                    axis_state[1] = new_value;
-                    if (old_value != new_value) {
-                        emit axisChanged(1, new_value);
-                    }
+
+                if (current_frame.hasChanges()) {
+                    publishFrame(timestamp);
                 }
-                break;
             }
-                
-            case LIBINPUT_EVENT_POINTER_BUTTON: {
-                // Handle button press/release events
-                struct libinput_event_pointer *pointer_event = 
-                    libinput_event_get_pointer_event(event);
-                    
-                uint32_t button = libinput_event_pointer_get_button(pointer_event);
-                enum libinput_button_state button_state = 
-                    libinput_event_pointer_get_button_state(pointer_event);
-                    
-                // Find the button in our mapping
-                for (int i = 0; i < m_button_mapping.size(); i++) {
-                    if (static_cast<uint32_t>(m_button_mapping[i]) == button) {
-                        bool state = (button_state == LIBINPUT_BUTTON_STATE_PRESSED);
-                        m_button_state[i] = state;
-                        emit buttonChanged(i, state);
-                        break;
-                    }
+            break;
+
+        case EV_ABS: {
+            int index = (!m_dropped && event.code < ABS_CNT) ? abs_index[event.code] : -1;
+            if (index >= 0) {
+                int new_value = applyCalibration(index, normalizeAxis(event.code, event.value));
+                if (axis_state[index] != new_value) {
+                    changeAxis(index, new_value, timestamp);
                 }
-                break;
             }
-                
-            case LIBINPUT_EVENT_POINTER_AXIS: {
-                // Handle scroll wheel or other axis events
-                struct libinput_event_pointer *pointer_event = 
-                    libinput_event_get_pointer_event(event);
-                    
-                enum libinput_pointer_axis axis = LIBINPUT_POINTER_AXIS_SCROLL_VERTICAL;
-                if (libinput_event_pointer_has_axis(pointer_event, axis)) {
-                    double value = libinput_event_pointer_get_axis_value(pointer_event, axis);
-                    
-                    // Map to an axis if we have any left
-                    if (axis_count > 2) {
-                        int old_value = axis_state[2];
-                        int new_value = applyCalibration(2, static_cast<int>(value * 10000));
-                        axis_state[2] = new_value;
-                        if (old_value != new_value) {
-                            emit axisChanged(2, new_value);
-                        }
-                    }
-                }
-                
-                axis = LIBINPUT_POINTER_AXIS_SCROLL_HORIZONTAL;
-                if (libinput_event_pointer_has_axis(pointer_event, axis)) {
-                    double value = libinput_event_pointer_get_axis_value(pointer_event, axis);
-                    
-                    // Map to an axis if we have any left
-                    if (axis_count > 3) {
-                        int old_value = axis_state[3];
-                        int new_value = applyCalibration(3, static_cast<int>(value * 10000));
-                        axis_state[3] = new_value;
-                        if (old_value != new_value) {
-                            emit axisChanged(3, new_value);
-                        }
-                    }
-                }
-                break;
+            break;
+        }
+
+        case EV_KEY: {
+            // Autorepeat (value 2) does not change the button state
+            int index = (!m_dropped && event.code < KEY_CNT && event.value != 2) ? key_index[event.code] : -1;
+            if (index >= 0) {
+                changeButton(index, event.value != 0, timestamp);
             }
-            
-            // Process other device-specific events here if needed
-                
-            default:
-                // Ignore other event types
-                break;
+            break;
         }
-        
-        libinput_event_destroy(event);
+
+        default:
+            break;
     }
 }
 
-int LibinputJoystick::applyCalibration(int axis, int value)
+int LibinputJoystick::convertAxis(int axis, int value) const
 {
-    std::vector<CalibrationData> cal_data = getCalibration();
-    if (axis < 0 || axis >= cal_data.size())
-        return value;
-        
-    const CalibrationData& cal = cal_data[axis];
-    
-    if (!cal.calibrate)
+    return applyCalibration(axis, normalizeAxis(m_axis_mapping[axis], value));
+}
+
+int LibinputJoystick::applyCalibration(int axis, int value) const
+{
+    if (axis < 0 || axis >= static_cast<int>(m_correction.size()))
         return value;
-        
-    // Apply calibration
-    if (value >= cal.center_min && value <= cal.center_max) {
-        // In deadzone, return 0
-        return 0;
-    } else if (value < cal.center_min) {
-        // Map from [range_min, center_min] to [-32767, 0]
-        double normalized = (static_cast<double>(value) - cal.center_min) / 
-                           (cal.center_min - cal.range_min);
-        int result = static_cast<int>(normalized * 32767);
-        return cal.invert ? -result : result;
-    } else { // value > cal.center_max
-        // Map from [center_max, range_max] to [0, 32767]
-        double normalized = (static_cast<double>(value) - cal.center_max) / 
-                           (cal.range_max - cal.center_max);
-        int result = static_cast<int>(normalized * 32767);
-        return cal.invert ? -result : result;
-    }
+
+    return applyCorrection(m_correction[axis], value);
 }
 
 int LibinputJoystick::getAxisState(int id)
@@ -475,37 +438,32 @@ std::vector<LibinputJoystick*> LibinputJoystick::getJoysticks()
 std::vector<Joystick::CalibrationData> LibinputJoystick::getCalibration()
 {
     std::vector<CalibrationData> cal_data;
-    cal_data.resize(axis_count);
-    
-    for (int i = 0; i < axis_count; i++) {
-        cal_data[i].calibrate = false;
-        cal_data[i].invert = false;
-        cal_data[i].center_min = 0;
-        cal_data[i].center_max = 0;
-        cal_data[i].range_min = -32767;
-        cal_data[i].range_max = 32767;
-    }
-    
+    std::transform(m_correction.begin(), m_correction.end(), std::back_inserter(cal_data), corr2cal);
     return cal_data;
 }
 
 void LibinputJoystick::setCalibration(const std::vector<CalibrationData>& data)
 {
-    // Store the calibration data for our internal use
-    // For libinput, we apply calibration in software since there's no kernel ioctl
-    // to set the calibration directly
+    // libinput has no calibration ioctl, the slopes are applied in software
+    if (data.size() != m_correction.size()) {
+        qWarning() << "Calibration for" << data.size() << "axes does not match" << axis_count << "axes";
+        return;
+    }
+
+    std::transform(data.begin(), data.end(), m_correction.begin(), cal2corr);
 }
 
 void LibinputJoystick::resetCalibration()
 {
-    // Reset to original calibration
-    // This is a no-op for libinput joysticks since we apply calibration in software
+    m_correction = m_orig_correction;
 }
 
 void LibinputJoystick::clearCalibration()
 {
-    // Clear calibration data
-    // This is a no-op for libinput joysticks since we apply calibration in software
+    struct js_corr corr;
+    memset(&corr, 0, sizeof(corr));
+    corr.type = JS_CORR_NONE;
+    std::fill(m_correction.begin(), m_correction.end(), corr);
 }
 
 std::vector<int> LibinputJoystick::getButtonMapping()
@@ -522,6 +480,7 @@ void LibinputJoystick::setButtonMapping(const std::vector<int>& mapping)
 {
     if (mapping.size() == button_count) {
         m_button_mapping = mapping;
+        buildCodeLookup(m_axis_mapping, m_button_mapping);
     }
 }
 
@@ -529,16 +488,36 @@ void LibinputJoystick::setAxisMapping(const std::vector<int>& mapping)
 {
     if (mapping.size() == axis_count) {
         m_axis_mapping = mapping;
+        buildCodeLookup(m_axis_mapping, m_button_mapping);
     }
 }
 
 void LibinputJoystick::correctCalibration(const std::vector<int>& mapping_old, const std::vector<int>& mapping_new)
 {
-    // Handle calibration adjustment after remapping
-    // This is a no-op for libinput joysticks since we apply calibration in software
-}
+    if (mapping_new.size() != m_correction.size()) {
+        return;
+    }
 
-std::string LibinputJoystick::getEvdev() const
-{
-    return filename;
+    int axes[ABS_CNT]; // axes[code] -> old_idx
+    std::fill(axes, axes + ABS_CNT, -1);
+    for (int i = 0; i < static_cast<int>(mapping_old.size()); i++) {
+        if (mapping_old[i] >= 0 && mapping_old[i] < ABS_CNT) {
+            axes[mapping_old[i]] = i;
+        }
+    }
+
+    // Each axis keeps the calibration of the code it now reads
+    std::vector<struct js_corr> corr_new(m_correction.size());
+    for (int i = 0; i < static_cast<int>(mapping_new.size()); i++) {
+        int code = mapping_new[i];
+        int old_idx = (code >= 0 && code < ABS_CNT) ? axes[code] : -1;
+        if (old_idx >= 0 && old_idx < static_cast<int>(m_correction.size())) {
+            corr_new[i] = m_correction[old_idx];
+        } else {
+            memset(&corr_new[i], 0, sizeof(corr_new[i]));
+            corr_new[i].type = JS_CORR_NONE;
+        }
+    }
+
+    m_correction = corr_new;
 }
@@ -23,33 +23,45 @@
 #include <QString>
 #include <vector>
 #include <memory>
+#include <linux/input.h>
 
 #include "joystick.h" // Include the base class header
+#include "utils/libinput_helper.h"
 
 // Forward declarations
-struct libinput;
 struct libinput_device;
-struct udev;
+struct libinput_event;
 
 /**
  * Joystick implementation using libinput backend
  * Suitable for Wayland and modern Linux systems
+ *
+ * libinput and udev find and open the device, through the context shared
+ * by all joysticks in LibinputHelper. libinput only reports pointer
+ * emulation for joysticks, though. The axes and buttons are read from the
+ * underlying event device, every ABS_* code scaled from its absinfo range.
  */
-class LibinputJoystick : public Joystick
+class LibinputJoystick : public Joystick, private LibinputHelper::DeviceListener
 {
     Q_OBJECT
 
 private:
-    // Private device-specific context
-    struct udev* m_udev;
-    struct libinput* m_libinput;
+    // Device in the shared context of LibinputHelper, nullptr once removed
     libinput_device* m_device;
-    QSocketNotifier* m_notifier;
     
     std::string m_syspath;
-    std::vector<bool> m_button_state;
     std::vector<int> m_axis_mapping;
     std::vector<int> m_button_mapping;
+    std::vector<struct js_corr> m_correction;       // Calibration of each axis, as fixed-point slopes
+    std::vector<struct js_corr> m_orig_correction;
+
+    // Scaling of one ABS_* code from its absinfo range to -32767..32767
+    struct AxisRange {
+        int minimum;
+        int64_t slope;      // 16.16 fixed point
+    };
+    AxisRange m_axis_range[ABS_CNT];    // By ABS_* code
+    bool m_dropped;                     // Events were lost, skip to the next SYN_REPORT
 
 public:
     /**
@@ -64,8 +76,10 @@ public:
     ~LibinputJoystick() override;
 
     // Override methods from Joystick
-    int getFd() const override;
     void update() override;
+
+    // Number of libinput events the shared context dispatched to this device
+    quint64 getLibinputEventCount() const;
     int getAxisState(int id) override;
 
     // Static helper methods
@@ -84,9 +98,6 @@ public:
     void setAxisMapping(const std::vector<int>& mapping) override;
     void correctCalibration(const std::vector<int>& mapping_old, const std::vector<int>& mapping_new) override;
 
-    // Get the evdev that this joystick device is based on
-    std::string getEvdev() const override;
-
 private slots:
     void onSocketActivated(int socket);
 
@@ -94,11 +105,26 @@ private:
     // Initialize device-specific resources
     bool initDevice();
     
-    // Process libinput events
-    void processEvent();
+    // Events of the device from the shared libinput context
+    void libinputEvent(libinput_event* event) override;
+
+    // Read the axes and buttons from the event device
+    void readEvents();
+
+    // Apply one event device event to the report being assembled
+    void processEvent(const struct input_event& event);
+
+    // Set up the scaling of an axis from its absinfo
+    void setAxisRange(int code, const struct input_absinfo& absinfo);
+
+    // Scale a raw ABS_* value to -32767..32767
+    int normalizeAxis(int code, int value) const;
     
-    // Apply calibration to raw axis values
-    int applyCalibration(int axis, int value);
+    // Apply calibration to raw axis values, without allocating
+    int applyCalibration(int axis, int value) const;
+
+    // Scale and calibrate a raw value of an axis
+    int convertAxis(int axis, int value) const override;
     
     // Prohibit copying
     LibinputJoystick(const LibinputJoystick&) = delete;
@@ -17,6 +17,7 @@
 
 #include "mainwindow.h"
 #include "configuredialog.h"
+#include "utils/benchmark.h"
 
 #include <QApplication>
 #include <QMessageBox>
@@ -58,6 +59,11 @@ int main(int argc, char *argv[])
         
         QCommandLineOption noConfigOption("no-config", "Skip configuration dialog");
         parser.addOption(noConfigOption);
+
+        QCommandLineOption benchmarkOption("benchmark",
+            "Run the filter, prediction, AO streaming, input read and input wakeup "
+            "(epoll/io_uring) benchmarks and exit");
+        parser.addOption(benchmarkOption);
         
         // Process the command line arguments
         parser.process(app);
@@ -70,6 +76,20 @@ int main(int argc, char *argv[])
             QLoggingCategory::setFilterRules("*.debug=false");
         }
         
+        // Benchmarks need no devices or windows
+        if (parser.isSet(benchmarkOption)) {
+            benchmarkFilters(std::cout);
+            std::cout << std::endl;
+            benchmarkPrediction(std::cout);
+            std::cout << std::endl;
+            benchmarkStreaming(std::cout);
+            std::cout << std::endl;
+            benchmarkInputReads(std::cout);
+            std::cout << std::endl;
+            benchmarkInputWakeups(std::cout);
+            return 0;
+        }
+
         // Set platform to Wayland if requested
         if (parser.isSet(waylandOption)) {
             qputenv("QT_QPA_PLATFORM", "wayland");
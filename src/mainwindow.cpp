@@ -18,8 +18,11 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "configuredialog.h"
+#include "control_thread.h"
 #include "joystick_factory.h"
+#include "simulated_ao_device.h"
 #include "utils/dialog_helper.h"
+#include "utils/input_device_index.h"
 #include "widgets/axis_widget.h"
 #include "widgets/rudder_widget.h"
 #include "widgets/throttle_widget.h"
@@ -28,9 +31,17 @@
 #include <QDebug>
 #include <QMessageBox>
 #include <QVBoxLayout>
+#include <QFile>
 #include <QFileDialog>
+#include <QSignalBlocker>
 #include <QTimer>
+#include <algorithm>
 #include <cmath>
+#include <sstream>
+#include <sys/stat.h>
+
+// Graph points added per channel on each GUI refresh, whatever the control rate
+static const size_t MaxGraphPointsPerRefresh = 20;
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -39,12 +50,21 @@ MainWindow::MainWindow(QWidget *parent) :
     waveformAiCtrl(nullptr),
     scaledData(nullptr),
     rawDataBufferLength(0),
+    aiMirrorXIndex(-1),
+    aiMirrorYIndex(-1),
     instantAoCtrl(nullptr),
-    joystick(nullptr),
-    xAxisValue(0.0),
-    yAxisValue(0.0),
+    aoChannelStart(0),
+    aoChannelCount(0),
+    controlThread(nullptr),
+    graphTimeOrigin(0.0),
+    latencyRefreshCount(0),
+    meterRefreshCount(0),
+    inputReactor(nullptr),
     xAxisMapping(0),
     yAxisMapping(1),
+    fineXAxisMapping(0),
+    fineYAxisMapping(1),
+    fineGain(0.1),
     xChannelMapping(0),
     yChannelMapping(1),
     invertX(false),
@@ -58,13 +78,33 @@ MainWindow::MainWindow(QWidget *parent) :
 {
     ui->setupUi(this);
 
-    // Initialize timer for regular updates
+    // Initialize timer for GUI refresh
     timer = new QTimer(this);
     connect(timer, &QTimer::timeout, this, &MainWindow::TimerTicked);
 
-    // Initialize arrays
-    aoData[0] = 0.0;
-    aoData[1] = 0.0;
+    // Create the control loop, AO errors are reported back on the GUI thread
+    controlThread = new ControlThread(this);
+    telemetryBatch.resize(ControlThread::TelemetryCapacity);
+    connect(controlThread, &ControlThread::aoWriteFailed, this, &MainWindow::OnAoWriteFailed,
+            Qt::QueuedConnection);
+
+    // Joystick input is read on its own thread, hotplug and failures come back here
+    inputReactor = new InputReactor(this);
+    connect(inputReactor, &InputReactor::deviceAdded, this, &MainWindow::OnInputDeviceAdded,
+            Qt::QueuedConnection);
+    connect(inputReactor, &InputReactor::deviceRemoved, this, &MainWindow::OnInputDeviceRemoved,
+            Qt::QueuedConnection);
+    connect(inputReactor, &InputReactor::joystickLost, this, &MainWindow::OnJoystickLost,
+            Qt::QueuedConnection);
+
+    // A lost joystick is waited for this long before it counts as disconnected
+    for (int role = 0; role < JoystickRoleCount; role++) {
+        joysticks[role].reconnectTimer = new QTimer(this);
+        joysticks[role].reconnectTimer->setSingleShot(true);
+        connect(joysticks[role].reconnectTimer, &QTimer::timeout, this, [this, role]() {
+            OnReconnectTimeout(static_cast<JoystickRole>(role));
+        });
+    }
 
     // Connect button signals
     connect(ui->btnConfiguration, &QPushButton::clicked, this, &MainWindow::ButtonConfigureClicked);
@@ -78,11 +118,20 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->actionExit, &QAction::triggered, this, &MainWindow::OnMenuExit);
     connect(ui->actionConfigure, &QAction::triggered, this, &MainWindow::OnMenuConfigure);
     connect(ui->actionJoystickTest, &QAction::triggered, this, &MainWindow::OnMenuJoystickTest);
+    connect(ui->actionSaveLatency, &QAction::triggered, this, &MainWindow::OnMenuSaveLatency);
     connect(ui->actionAbout, &QAction::triggered, this, &MainWindow::OnMenuAbout);
 
     // Connect settings change signals
     connect(ui->cmbJoystick, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &MainWindow::OnJoystickSelectionChanged);
+    connect(ui->cmbFineJoystick, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::OnFineJoystickSelectionChanged);
+    connect(ui->cmbFineXAxis, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::OnFineXAxisMappingChanged);
+    connect(ui->cmbFineYAxis, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::OnFineYAxisMappingChanged);
+    connect(ui->spinFineGain, QOverload<double>::of(&QDoubleSpinBox::valueChanged),
+            this, &MainWindow::OnFineGainChanged);
     connect(ui->cmbBackend, QOverload<int>::of(&QComboBox::currentIndexChanged),
             this, &MainWindow::OnBackendSelectionChanged);
     connect(ui->cmbXAxis, QOverload<int>::of(&QComboBox::currentIndexChanged),
@@ -108,6 +157,16 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+    // Stop the control loop before the AO control goes away
+    StopControlLoop();
+    aoStream.reset();
+
+    // The input thread must let go of the joysticks before they are destroyed
+    for (int role = 0; role < JoystickRoleCount; role++) {
+        CloseJoystick(static_cast<JoystickRole>(role));
+    }
+    inputReactor->stop();
+
     // Stop any running operations
     if (waveformAiCtrl) {
         waveformAiCtrl->Stop();
@@ -166,6 +225,9 @@ void MainWindow::Initialize()
     // Configure DAQ devices if available
     ConfigureDevice();
 
+    // Start reading input before the first joystick is opened
+    StartInputReactor();
+
     // Scan for joysticks
     JoystickRefreshClicked();
 
@@ -181,17 +243,20 @@ void MainWindow::Initialize()
     ui->spinXScale->setValue(xScale);
     ui->spinYScale->setValue(yScale);
     ui->spinDeadzone->setValue(deadzone);
+    UpdateControlSettings();
 
     // Set initial joystick backend selection
     if (configure.joystickBackend == "Legacy") {
         ui->cmbBackend->setCurrentIndex(1);
     } else if (configure.joystickBackend == "Libinput") {
         ui->cmbBackend->setCurrentIndex(2);
+    } else if (configure.joystickBackend == "Evdev") {
+        ui->cmbBackend->setCurrentIndex(3);
     } else { // Auto
         ui->cmbBackend->setCurrentIndex(0);
     }
 
-    // Start the timer for regular updates (50Hz)
+    // Start the timer for GUI refresh (50Hz), the mirror is driven by the control loop
     timer->start(20);
 
     // Update status bar
@@ -203,6 +268,9 @@ void MainWindow::Initialize()
 
 void MainWindow::ConfigureDevice()
 {
+    // The control loop must not touch the AO control while it is reconfigured
+    StopControlLoop();
+
     // Configure analog input if specified
     if (!configure.aiDeviceName.isEmpty()) {
         ConfigureAI();
@@ -212,9 +280,28 @@ void MainWindow::ConfigureDevice()
     if (!configure.aoDeviceName.isEmpty()) {
         ConfigureAO();
     }
+    ConfigureAOStream();
 
     // Configure graph
     ConfigureGraph();
+
+    // Restart the control loop with the new configuration
+    StartControlLoop();
+}
+
+// Offset of a physical AI channel within each acquired frame, -1 if it is not acquired
+static int AiFrameIndex(int channel, Conversion* conversion)
+{
+    if (channel < 0) {
+        return -1;
+    }
+
+    int index = channel - conversion->getChannelStart();
+    if (index < 0 || index >= conversion->getChannelCount()) {
+        qWarning() << "Mirror readback channel" << channel << "is not acquired";
+        return -1;
+    }
+    return index;
 }
 
 void MainWindow::ConfigureAI()
@@ -249,6 +336,10 @@ void MainWindow::ConfigureAI()
         valueRanges->setItem(i, configure.aiValueRange);
     }
 
+    // Locate the mirror readback channels within each acquired frame
+    aiMirrorXIndex = AiFrameIndex(configure.aiMirrorXChannel, conversion);
+    aiMirrorYIndex = AiFrameIndex(configure.aiMirrorYChannel, conversion);
+
     // Calculate buffer size
     rawDataBufferLength = conversion->getChannelCount() * configure.sectionLength;
     if (scaledData != nullptr) {
@@ -302,12 +393,15 @@ void MainWindow::ConfigureAO()
     aoChannelStart = configure.aoChannelStart;
     aoChannelCount = configure.aoChannelCount;
 
-    // Set the channel data range
+    // Set the channel data range (the array is indexed by physical channel)
     Array<ValueRange>* valueRanges = instantAoCtrl->getChannelRanges();
-    for (int i = 0; i < aoChannelCount; i++) {
+    for (int i = aoChannelStart; i < aoChannelStart + aoChannelCount && i < valueRanges->getCount(); i++) {
         valueRanges->setItem(i, configure.aoValueRange);
     }
 
+    // Precompute the volt transform of every written channel from its range
+    aoTransform.configure(instantAoCtrl, aoChannelStart, aoChannelCount);
+
     // Update the UI
     ui->lblAODeviceValue->setText(configure.aoDeviceName);
     ui->lblAOChanValue->setText(QString("%1 - %2").arg(aoChannelStart)
@@ -333,6 +427,44 @@ void MainWindow::ConfigureAO()
         ui->cmbYChannel->setCurrentIndex(1);
         yChannelMapping = aoChannelStart + 1;
     }
+
+    UpdateControlSettings();
+}
+
+void MainWindow::ConfigureAOStream()
+{
+    aoStream.reset();
+
+    std::unique_ptr<BufferedAoDevice> device;
+    if (configure.aoOutputEngine == "Buffered") {
+        if (configure.aoDeviceName.isEmpty()) {
+            return;
+        }
+        device.reset(new BdaqBufferedAoDevice(configure.aoDeviceName.toStdWString(),
+                                              configure.aoProfilePath.toStdWString(),
+                                              configure.aoValueRange));
+    } else if (configure.aoOutputEngine == "Simulated") {
+        // Runs without hardware; the configured range stands in for the device's
+        if (configure.aoDeviceName.isEmpty()) {
+            aoTransform.configure(configure.aoValueRange, configure.aoChannelStart, configure.aoChannelCount);
+        }
+        device.reset(new SimulatedAoDevice());
+    } else {
+        return;
+    }
+
+    AoStream::Interpolation interpolation = configure.streamInterpolation == "Cubic" ? AoStream::Cubic
+                                                                                     : AoStream::Linear;
+    int chunkSamples = static_cast<int>(static_cast<int64_t>(configure.streamRate) *
+                                        configure.streamRefillInterval / 1000);
+
+    aoStream.reset(new AoStream(std::move(device)));
+    ErrorCode errorCode = aoStream->configure(aoTransform, configure.streamRate, chunkSamples,
+                                              interpolation, configure.controlRate);
+    if (BioFailed(errorCode)) {
+        aoStream.reset();
+        CheckError(errorCode);
+    }
 }
 
 void MainWindow::ConfigureGraph()
@@ -341,34 +473,23 @@ void MainWindow::ConfigureGraph()
         // Setup the graph for visualization
         graph->Clear();
 
-        // Set Y-coordinate range to match the AO value range
-        if (!configure.aoDeviceName.isEmpty()) {
-            Array<ValueRange>* valueRanges = instantAoCtrl->getChannelRanges();
-            ValueRange range = valueRanges->getItem(0);
-
-            // Extract min and max from the range
-            double min = 0.0;
-            double max = 0.0;
-
-            switch (range) {
-                case V_Neg10To10:
-                    min = -10.0;
-                    max = 10.0;
-                    break;
-                case V_Neg5To5:
-                    min = -5.0;
-                    max = 5.0;
-                    break;
-                case V_0To10:
-                    min = 0.0;
-                    max = 10.0;
-                    break;
-                default:
-                    min = -10.0;
-                    max = 10.0;
-                    break;
+        // Set Y-coordinate range to cover the ranges of the plotted AO channels,
+        // whichever engine drives them
+        const int channels[] = { xChannelMapping, yChannelMapping };
+        bool found = false;
+        double min = 0.0;
+        double max = 0.0;
+        for (int channel : channels) {
+            if (!aoTransform.contains(channel)) {
+                continue;
             }
+            const AoChannelTransform& transform = aoTransform.channel(channel);
+            min = found ? std::min(min, transform.minVolts) : transform.minVolts;
+            max = found ? std::max(max, transform.maxVolts) : transform.maxVolts;
+            found = true;
+        }
 
+        if (found) {
             graph->m_yCordRangeMin = min;
             graph->m_yCordRangeMax = max;
         }
@@ -387,7 +508,7 @@ void MainWindow::UpdateUI()
 {
     bool hasAI = !configure.aiDeviceName.isEmpty();
     bool hasAO = !configure.aoDeviceName.isEmpty();
-    bool hasJoystick = joystick != nullptr;
+    bool hasJoystick = joysticks[CoarseJoystick].joystick != nullptr;
 
     // Enable/disable buttons based on state
     ui->btnStart->setEnabled(hasAI || hasAO);
@@ -397,22 +518,16 @@ void MainWindow::UpdateUI()
 
     // Update channel visualizations
     if (hasAO) {
-        ui->lblXVoltage->setText(QString("X Voltage: %.2fV").arg(aoData[0]));
-        ui->lblYVoltage->setText(QString("Y Voltage: %.2fV").arg(aoData[1]));
+        ControlSnapshot state = controlThread->snapshot();
+        ui->lblXVoltage->setText(QString("X Voltage: %1V").arg(state.xVolts, 0, 'f', 2));
+        ui->lblYVoltage->setText(QString("Y Voltage: %1V").arg(state.yVolts, 0, 'f', 2));
     } else {
         ui->lblXVoltage->setText("X Voltage: N/A");
         ui->lblYVoltage->setText("Y Voltage: N/A");
     }
 
     // Update joystick info
-    if (hasJoystick) {
-        ui->joystickLabel->setText(QString("%1 (%2 axes, %3 buttons)")
-                                 .arg(joystick->getName())
-                                 .arg(joystick->getAxisCount())
-                                 .arg(joystick->getButtonCount()));
-    } else {
-        ui->joystickLabel->setText("No joystick connected");
-    }
+    UpdateJoystickLabel();
 }
 
 void MainWindow::ButtonConfigureClicked()
@@ -466,10 +581,6 @@ void MainWindow::ButtonStopClicked()
 
 void MainWindow::ButtonCenterClicked()
 {
-    // Set joystick values to zero
-    xAxisValue = 0.0;
-    yAxisValue = 0.0;
-
     // Update visualizations
     joystickWidget->setXAxis(0.0);
     joystickWidget->setYAxis(0.0);
@@ -482,8 +593,8 @@ void MainWindow::ButtonCenterClicked()
         throttleWidget->setPos(0.0);
     }
 
-    // Send zeros to mirror
-    UpdateMirrorPosition(0.0, 0.0);
+    // Send zeros to mirror on the next control tick
+    controlThread->center();
 
     // Update status
     ui->lblStatus->setText("Status: Mirror centered");
@@ -496,53 +607,53 @@ void MainWindow::DivValueChanged(int value)
     }
 }
 
+static QString JoystickEntry(const JoystickDescription& desc)
+{
+    return QString("%1 (%2 axes, %3 buttons)")
+           .arg(QString::fromStdString(desc.name))
+           .arg(desc.axis_count)
+           .arg(desc.button_count);
+}
+
 void MainWindow::JoystickRefreshClicked()
 {
     // Clear the combo box
     ui->cmbJoystick->clear();
 
-    // Get the selected backend
-    JoystickBackend backend = JoystickBackend::AUTO;
-    switch (ui->cmbBackend->currentIndex()) {
-    case 1:
-        backend = JoystickBackend::LEGACY;
-        break;
-    case 2:
-        backend = JoystickBackend::LIBINPUT;
-        break;
-    default:
-        backend = JoystickBackend::AUTO;
-        break;
-    }
-
     // Get available joysticks
-    std::vector<JoystickDescription> joysticks = JoystickFactory::getJoysticks(backend);
+    std::vector<JoystickDescription> list = JoystickFactory::getJoysticks(SelectedBackend());
 
-    if (joysticks.empty()) {
+    // The fine joystick stays open if it is still there
+    SyncJoystickCombo(ui->cmbFineJoystick, list, FineJoystick);
+
+    if (list.empty()) {
         ui->joystickLabel->setText("No joysticks found");
         return;
     }
 
-    // Add joysticks to combo box
-    for (const auto& desc : joysticks) {
-        QString name = QString::fromStdString(desc.name);
-        QString entry = QString("%1 (%2 axes, %3 buttons)")
-                        .arg(name)
-                        .arg(desc.axis_count)
-                        .arg(desc.button_count);
-
-        // Store the device path as user data
-        ui->cmbJoystick->addItem(entry, QString::fromStdString(desc.filename));
-    }
+    // Add joysticks to combo box, with the device path as user data. Adding
+    // the first entry would select it, so only the final choice is opened.
+    const Joystick* fine = joysticks[FineJoystick].joystick.get();
+    int index = 0;
+    {
+        QSignalBlocker blocker(ui->cmbJoystick);
+        for (const auto& desc : list) {
+            ui->cmbJoystick->addItem(JoystickEntry(desc), QString::fromStdString(desc.filename));
+        }
 
-    // Select the first joystick
-    if (ui->cmbJoystick->count() > 0) {
-        ui->cmbJoystick->setCurrentIndex(0);
+        // Select the first joystick that is not the fine one
+        if (fine && ui->cmbJoystick->count() > 1 &&
+            ui->cmbJoystick->itemData(0).toString() == QString::fromStdString(fine->getFilename())) {
+            index = 1;
+        }
+        ui->cmbJoystick->setCurrentIndex(index);
     }
+    OnJoystickSelectionChanged(index);
 }
 
 void MainWindow::JoystickCalibrateClicked()
 {
+    const Joystick* joystick = joysticks[CoarseJoystick].joystick.get();
     if (!joystick) {
         QMessageBox::warning(this, "Warning", "No joystick connected");
         return;
@@ -557,81 +668,87 @@ void MainWindow::JoystickCalibrateClicked()
     }
 }
 
-void MainWindow::OnJoystickAxisChanged(int number, int value)
+void MainWindow::TimerTicked()
 {
-    // Store the normalized value (-1.0 to 1.0)
-    double normalizedValue = value / 32767.0;
-
-    // Limit to valid range
-    if (normalizedValue < -1.0) normalizedValue = -1.0;
-    if (normalizedValue > 1.0) normalizedValue = 1.0;
-
-    // Update axes array
-    if (number >= 0 && number < joystickAxes.size()) {
-        joystickAxes[number] = normalizedValue;
-
-        // Update main axis values if this axis is mapped
-        if (number == xAxisMapping) {
-            xAxisValue = normalizedValue;
-        }
-
-        if (number == yAxisMapping) {
-            yAxisValue = normalizedValue;
-        }
+    // Report rates settle within seconds, refresh them twice a second
+    if (++meterRefreshCount >= 25) {
+        meterRefreshCount = 0;
+        UpdateJoystickLabel();
+        AdaptFilterDefaults();
     }
-}
 
-void MainWindow::OnJoystickButtonChanged(int number, bool value)
-{
-    // Store button state
-    if (number >= 0 && number < joystickButtons.size()) {
-        joystickButtons[number] = value;
+    // Refresh the GUI from the latest control loop state
+    if (!controlThread->isRunning()) {
+        return;
     }
-}
 
-void MainWindow::TimerTicked()
-{
-    // Update the AO outputs based on joystick position
-    if (!configure.aoDeviceName.isEmpty() && instantAoCtrl) {
-        // Apply deadzone to current values
-        double deadzoneX = xAxisValue;
-        double deadzoneY = yAxisValue;
-        ApplyDeadzone(deadzoneX, deadzoneY);
+    // Take every tick recorded since the last refresh in one batch
+    size_t count = controlThread->drainTelemetry(telemetryBatch.data(), telemetryBatch.size());
+    if (count == 0) {
+        return;
+    }
+    const ControlSnapshot& state = telemetryBatch[count - 1];
 
-        // Apply inversion if needed
-        if (invertX) deadzoneX = -deadzoneX;
-        if (invertY) deadzoneY = -deadzoneY;
+    // Percentiles only change slowly, refresh them twice a second
+    if (++latencyRefreshCount >= 25) {
+        latencyRefreshCount = 0;
+        UpdateLatencyPanel();
+    }
 
-        // Apply scaling
-        deadzoneX *= xScale;
-        deadzoneY *= yScale;
+    // Update joystick visualization
+    joystickWidget->setXAxis(state.x);
+    joystickWidget->setYAxis(state.y);
 
-        // Update joystick visualization
-        joystickWidget->setXAxis(deadzoneX);
-        joystickWidget->setYAxis(deadzoneY);
+    // Update supplementary visualizations if available
+    if (rudderWidget && rudderWidget->isVisible()) {
+        rudderWidget->setPos(state.smoothedX);
+    }
 
-        // Apply smoothing if needed
-        static double smoothedX = 0.0;
-        static double smoothedY = 0.0;
-        double smoothingFactor = 0.3;  // 0.0-1.0, higher is less smoothing
+    if (throttleWidget && throttleWidget->isVisible()) {
+        throttleWidget->setPos(state.smoothedY);
+    }
 
-        smoothedX = smoothedX * (1.0 - smoothingFactor) + deadzoneX * smoothingFactor;
-        smoothedY = smoothedY * (1.0 - smoothingFactor) + deadzoneY * smoothingFactor;
+    // Update voltage labels
+    ui->lblXVoltage->setText(QString("X Voltage: %1V").arg(state.xVolts, 0, 'f', 2));
+    ui->lblYVoltage->setText(QString("Y Voltage: %1V").arg(state.yVolts, 0, 'f', 2));
 
-        // Update supplementary visualizations if available
-        if (rudderWidget && rudderWidget->isVisible()) {
-            rudderWidget->setPos(smoothedX);
-        }
+    // Update graph with mirror position, decimated so the number of points
+    // per refresh does not grow with the control rate
+    if (graph) {
+        size_t stride = (count + MaxGraphPointsPerRefresh - 1) / MaxGraphPointsPerRefresh;
+        QVector<QPointF> xTrace;
+        QVector<QPointF> yTrace;
+        xTrace.reserve(MaxGraphPointsPerRefresh);
+        yTrace.reserve(MaxGraphPointsPerRefresh);
+
+        for (size_t i = (count - 1) % stride; i < count; i += stride) {
+            const ControlSnapshot& record = telemetryBatch[i];
+
+            // If time exceeds the display window, reset
+            double time = record.time - graphTimeOrigin;
+            if (time > 10.0 || time < 0.0) {
+                graph->Clear();
+                xTrace.clear();
+                yTrace.clear();
+                graphTimeOrigin = record.time;
+                time = 0.0;
+            }
 
-        if (throttleWidget && throttleWidget->isVisible()) {
-            throttleWidget->setPos(smoothedY);
+            xTrace.append(QPointF(time, record.xVolts));
+            yTrace.append(QPointF(time, record.yVolts));
         }
 
-        // Update mirror position
-        UpdateMirrorPosition(smoothedX, smoothedY);
+        // Position trace (channel 0 for X, channel 1 for Y)
+        graph->AddPoints(0, xTrace);
+        graph->AddPoints(1, yTrace);
     }
 }
 
+void MainWindow::OnAoWriteFailed(int errorCode)
+{
+    CheckError(static_cast<ErrorCode>(errorCode));
+}
+
 void MainWindow::OnMenuExit()
 {
     close();
@@ -654,6 +771,9 @@ void MainWindow::OnMenuConfigure()
         case 2:
             configure.joystickBackend = "Libinput";
             break;
+        case 3:
+            configure.joystickBackend = "Evdev";
+            break;
         default:
             configure.joystickBackend = "Auto";
             break;
@@ -670,6 +790,14 @@ void MainWindow::OnMenuConfigure()
             // Reconfigure devices
             ConfigureDevice();
 
+            // Moving the input thread or changing how it waits needs a restart,
+            // the joystick stays registered
+            if (configure.inputCpu != inputReactor->getCpu() ||
+                InputBackendFromConfig() != inputReactor->getBackend()) {
+                inputReactor->stop();
+                StartInputReactor();
+            }
+
             // Update UI settings from configuration
             invertX = configure.invertX;
             invertY = configure.invertY;
@@ -689,6 +817,8 @@ void MainWindow::OnMenuConfigure()
                 ui->cmbBackend->setCurrentIndex(1);
             } else if (configure.joystickBackend == "Libinput") {
                 ui->cmbBackend->setCurrentIndex(2);
+            } else if (configure.joystickBackend == "Evdev") {
+                ui->cmbBackend->setCurrentIndex(3);
             } else { // Auto
                 ui->cmbBackend->setCurrentIndex(0);
             }
@@ -704,7 +834,7 @@ void MainWindow::OnMenuConfigure()
 
 void MainWindow::OnMenuJoystickTest()
 {
-    if (!joystick) {
+    if (!joysticks[CoarseJoystick].joystick) {
         QMessageBox::warning(this, "Warning", "No joystick connected");
         return;
     }
@@ -714,6 +844,54 @@ void MainWindow::OnMenuJoystickTest()
                            "The joystick test feature is not implemented yet.");
 }
 
+void MainWindow::OnMenuSaveLatency()
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Save Latency Statistics",
+                                                    "latency.txt", "Text files (*.txt)");
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    std::ostringstream stream;
+    controlThread->writeStatistics(stream);
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        QMessageBox::warning(this, "Error",
+                             QString("Failed to write %1: %2").arg(fileName, file.errorString()));
+        return;
+    }
+    file.write(stream.str().c_str());
+}
+
+void MainWindow::UpdateLatencyPanel()
+{
+    auto micros = [this](ControlThread::Stage stage, double percentile) {
+        return controlThread->histogram(stage).percentile(percentile) / 1000.0;
+    };
+
+    ui->lblLatency->setText(QString("Loop: wake p99 %1 us | tick p99 %2 us | AO p99 %3 us | "
+                                    "input to AO p99 %4 us | missed %5")
+                            .arg(micros(ControlThread::WakeupLatency, 99.0), 0, 'f', 1)
+                            .arg(micros(ControlThread::TickTotal, 99.0), 0, 'f', 1)
+                            .arg(micros(ControlThread::AoWrite, 99.0), 0, 'f', 1)
+                            .arg(micros(ControlThread::InputToOutput, 99.0), 0, 'f', 1)
+                            .arg(controlThread->missedDeadlines()));
+
+    // Full breakdown on hover
+    QString details;
+    for (int i = 0; i < ControlThread::StageCount; i++) {
+        ControlThread::Stage stage = static_cast<ControlThread::Stage>(i);
+        details += QString("%1: p50 %2, p99 %3, p99.9 %4, max %5 us\n")
+                   .arg(ControlThread::stageName(stage))
+                   .arg(micros(stage, 50.0), 0, 'f', 1)
+                   .arg(micros(stage, 99.0), 0, 'f', 1)
+                   .arg(micros(stage, 99.9), 0, 'f', 1)
+                   .arg(controlThread->histogram(stage).max() / 1000.0, 0, 'f', 1);
+    }
+    ui->lblLatency->setToolTip(details.trimmed());
+}
+
 void MainWindow::OnMenuAbout()
 {
     QString aboutText =
@@ -732,67 +910,28 @@ void MainWindow::OnJoystickSelectionChanged(int index)
         return;
     }
 
-    // Disconnect current joystick if any
-    joystick.reset();
+    // Picking a joystick by hand ends a reconnect, then disconnect current joystick if any
+    CancelReconnect(CoarseJoystick);
+    CloseJoystick(CoarseJoystick);
 
     // Get joystick path
     QString path = ui->cmbJoystick->itemData(index).toString();
 
     try {
-        // Get joystick backend from UI
-        JoystickBackend backend = JoystickBackend::AUTO;
-        switch (ui->cmbBackend->currentIndex()) {
-        case 1:
-            backend = JoystickBackend::LEGACY;
-            break;
-        case 2:
-            backend = JoystickBackend::LIBINPUT;
-            break;
-        default:
-            backend = JoystickBackend::AUTO;
-            break;
-        }
-
-        // Create the joystick
-        joystick = JoystickFactory::createJoystick(path.toStdString(), backend);
-
-        // Initialize axis and button lists
-        joystickAxes.resize(joystick->getAxisCount(), 0.0);
-        joystickButtons.resize(joystick->getButtonCount(), false);
+        OpenJoystick(CoarseJoystick, path.toStdString());
+        const Joystick* joystick = joysticks[CoarseJoystick].joystick.get();
 
-        // Connect signals
-        connect(joystick.get(), &Joystick::axisChanged, this, &MainWindow::OnJoystickAxisChanged);
-        connect(joystick.get(), &Joystick::buttonChanged, this, &MainWindow::OnJoystickButtonChanged);
-
-        // Update UI
-        ui->joystickLabel->setText(QString("Connected: %1 (%2 axes, %3 buttons)")
-                                .arg(joystick->getName())
-                                .arg(joystick->getAxisCount())
-                                .arg(joystick->getButtonCount()));
-
-        ui->btnJoystickCalibrate->setEnabled(true);
-
-        // Update axis mappings comboboxes
-        ui->cmbXAxis->clear();
-        ui->cmbYAxis->clear();
-
-        for (int i = 0; i < joystick->getAxisCount(); i++) {
-            QString axisName = QString("Axis %1").arg(i);
-            ui->cmbXAxis->addItem(axisName, i);
-            ui->cmbYAxis->addItem(axisName, i);
-        }
-
-        // Set defaults
+        // Update axis mappings comboboxes, with defaults
+        FillAxisCombos(ui->cmbXAxis, ui->cmbYAxis, joystick->getAxisCount());
         if (joystick->getAxisCount() >= 1) {
-            ui->cmbXAxis->setCurrentIndex(0);
             xAxisMapping = 0;
         }
-
         if (joystick->getAxisCount() >= 2) {
-            ui->cmbYAxis->setCurrentIndex(1);
             yAxisMapping = 1;
         }
 
+        UpdateControlSettings();
+
         // Update status
         ui->lblStatus->setText(QString("Joystick connected: %1").arg(joystick->getName()));
 
@@ -807,6 +946,456 @@ void MainWindow::OnJoystickSelectionChanged(int index)
     }
 }
 
+void MainWindow::OnFineJoystickSelectionChanged(int index)
+{
+    if (index < 0 || index >= ui->cmbFineJoystick->count()) {
+        return;
+    }
+
+    CancelReconnect(FineJoystick);
+    CloseJoystick(FineJoystick);
+    ui->cmbFineXAxis->clear();
+    ui->cmbFineYAxis->clear();
+
+    // The first entry is "None"
+    QString path = ui->cmbFineJoystick->itemData(index).toString();
+    if (path.isEmpty()) {
+        UpdateJoystickLabel();
+        return;
+    }
+
+    try {
+        OpenJoystick(FineJoystick, path.toStdString());
+        const Joystick* joystick = joysticks[FineJoystick].joystick.get();
+
+        FillAxisCombos(ui->cmbFineXAxis, ui->cmbFineYAxis, joystick->getAxisCount());
+        fineXAxisMapping = 0;
+        fineYAxisMapping = joystick->getAxisCount() >= 2 ? 1 : 0;
+        UpdateControlSettings();
+
+        ui->lblStatus->setText(QString("Fine joystick connected: %1").arg(joystick->getName()));
+
+    } catch (const std::exception& e) {
+        QMessageBox::critical(this, "Error", QString("Failed to open fine joystick: %1").arg(e.what()));
+
+        QSignalBlocker blocker(ui->cmbFineJoystick);
+        ui->cmbFineJoystick->setCurrentIndex(0);
+        UpdateJoystickLabel();
+    }
+}
+
+InputReactor::Backend MainWindow::InputBackendFromConfig() const
+{
+    return configure.inputBackend == "io_uring" ? InputReactor::IoUringPoll : InputReactor::Epoll;
+}
+
+void MainWindow::StartInputReactor()
+{
+    inputReactor->setCpu(configure.inputCpu);
+    inputReactor->setBackend(InputBackendFromConfig());
+    inputReactor->start(QThread::TimeCriticalPriority);
+}
+
+QString MainWindow::RoleName(JoystickRole role)
+{
+    return role == FineJoystick ? "Fine joystick" : "Joystick";
+}
+
+// Look up the input device behind a node, following symlinks such as /dev/input/by-id
+static bool FindInputDevice(const std::string& path, InputDeviceInfo& info)
+{
+    if (InputDeviceIndex::instance().findByNode(path, info)) {
+        return true;
+    }
+
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISCHR(st.st_mode) &&
+           InputDeviceIndex::instance().findByNumber(st.st_rdev, info);
+}
+
+void MainWindow::OpenJoystick(JoystickRole role, const std::string& path)
+{
+    JoystickSlot& slot = joysticks[role];
+
+    // Remember which device this is, so it can be found again after a replug
+    InputDeviceInfo info;
+    std::string key;
+    if (FindInputDevice(path, info)) {
+        key = info.stableKey();
+    }
+
+    // Both roles reading one device would only double it, also when one
+    // opened its js node and the other its event node
+    for (int other = 0; other < JoystickRoleCount; other++) {
+        const JoystickSlot& otherSlot = joysticks[other];
+        if (other == role || !otherSlot.joystick) {
+            continue;
+        }
+        if (otherSlot.joystick->getFilename() == path || (!key.empty() && otherSlot.key == key)) {
+            throw std::runtime_error(path + " is already open as " +
+                                     RoleName(static_cast<JoystickRole>(other)).toStdString());
+        }
+    }
+
+    // Create the joystick with the backend from the UI
+    slot.backend = SelectedBackend();
+    slot.joystick = JoystickFactory::createJoystick(path, slot.backend);
+    slot.key = key;
+    slot.filtersAdapted = false;
+
+    AttachJoystick(role);
+}
+
+void MainWindow::CloseJoystick(JoystickRole role)
+{
+    JoystickSlot& slot = joysticks[role];
+    controlThread->setInputSource(nullptr, role);
+
+    if (slot.joystick) {
+        inputReactor->removeJoystick(slot.joystick.get());
+        slot.joystick.reset();
+    }
+}
+
+void MainWindow::AttachJoystick(JoystickRole role)
+{
+    Joystick* joystick = joysticks[role].joystick.get();
+
+    // The control loop reads the joystick state directly from its snapshot buffer
+    controlThread->setInputSource(joystick->getSnapshotSource(), role);
+    connect(joystick, &Joystick::frameChanged, controlThread, &ControlThread::notifyInput,
+            Qt::DirectConnection);
+
+    // Without the input thread the joystick keeps reading on the GUI thread
+    if (!inputReactor->addJoystick(joystick)) {
+        qWarning() << "Reading joystick on the GUI thread";
+    }
+
+    if (role == CoarseJoystick) {
+        ui->btnJoystickCalibrate->setEnabled(true);
+    }
+    UpdateJoystickLabel();
+}
+
+void MainWindow::UpdateJoystickLabel()
+{
+    QStringList lines;
+    QString details;
+    for (int role = 0; role < JoystickRoleCount; role++) {
+        const JoystickSlot& slot = joysticks[role];
+        QString prefix = role == FineJoystick ? "Fine: " : "Connected: ";
+
+        if (slot.joystick) {
+            lines << prefix + QString("%1 (%2 axes, %3 buttons)")
+                              .arg(slot.joystick->getName())
+                              .arg(slot.joystick->getAxisCount())
+                              .arg(slot.joystick->getButtonCount());
+
+            const ReportMeter& meter = slot.joystick->getReportMeter();
+            if (meter.reportRate() > 0.0) {
+                lines << QString("    %1 Hz, jitter %2x, %3 dropped, %4 duplicate")
+                         .arg(meter.reportRate(), 0, 'f', 0)
+                         .arg(meter.jitter(), 0, 'f', 2)
+                         .arg(meter.dropped())
+                         .arg(meter.duplicates());
+            } else if (meter.reports() > 0) {
+                lines << "    Measuring report rate...";
+            }
+
+            // Interval breakdown on hover
+            const LatencyHistogram& intervals = meter.intervals();
+            details += QString("%1: %2 reports, interval p50 %3, p90 %4, p99 %5, max %6 ms\n")
+                       .arg(RoleName(static_cast<JoystickRole>(role)))
+                       .arg(meter.reports())
+                       .arg(intervals.percentile(50.0) / 1e6, 0, 'f', 2)
+                       .arg(intervals.percentile(90.0) / 1e6, 0, 'f', 2)
+                       .arg(intervals.percentile(99.0) / 1e6, 0, 'f', 2)
+                       .arg(intervals.max() / 1e6, 0, 'f', 2);
+        } else if (slot.reconnectTimer->isActive()) {
+            lines << QString("%1 reconnecting: %2").arg(RoleName(static_cast<JoystickRole>(role)))
+                                                   .arg(slot.reconnectName);
+        } else if (role == CoarseJoystick) {
+            lines << "No joystick connected";
+        }
+    }
+
+    ui->joystickLabel->setText(lines.join("\n"));
+    ui->joystickLabel->setToolTip(details.trimmed());
+}
+
+void MainWindow::AdaptFilterDefaults()
+{
+    // The fine joystick only trims, the coarse one sets the filter timing
+    JoystickSlot& slot = joysticks[CoarseJoystick];
+    if (!slot.joystick || slot.filtersAdapted) {
+        return;
+    }
+
+    const ReportMeter& meter = slot.joystick->getReportMeter();
+    if (meter.reportRate() <= 0.0) {
+        return;
+    }
+    slot.filtersAdapted = true;
+
+    // Settings edited in the configure dialog are left alone
+    AxisFilterConfig adapted = AxisFilterConfig::forDevice(meter.reportRate(), meter.jitter());
+    bool changed = false;
+    if (configure.xFilter == filterDefaults && configure.xFilter != adapted) {
+        configure.xFilter = adapted;
+        changed = true;
+    }
+    if (configure.yFilter == filterDefaults && configure.yFilter != adapted) {
+        configure.yFilter = adapted;
+        changed = true;
+    }
+    filterDefaults = adapted;
+
+    if (changed) {
+        qDebug() << "Filters fitted to" << meter.reportRate() << "Hz reports, jitter" << meter.jitter();
+        if (configureDialog) {
+            configureDialog->SetConfigureParameter(configure);
+        }
+        UpdateControlSettings();
+    }
+}
+
+void MainWindow::FillAxisCombos(QComboBox *xCombo, QComboBox *yCombo, int axisCount)
+{
+    xCombo->clear();
+    yCombo->clear();
+
+    for (int i = 0; i < axisCount; i++) {
+        QString axisName = QString("Axis %1").arg(i);
+        xCombo->addItem(axisName, i);
+        yCombo->addItem(axisName, i);
+    }
+
+    if (axisCount >= 1) {
+        xCombo->setCurrentIndex(0);
+    }
+    if (axisCount >= 2) {
+        yCombo->setCurrentIndex(1);
+    }
+}
+
+JoystickBackend MainWindow::SelectedBackend() const
+{
+    switch (ui->cmbBackend->currentIndex()) {
+    case 1:
+        return JoystickBackend::LEGACY;
+    case 2:
+        return JoystickBackend::LIBINPUT;
+    case 3:
+        return JoystickBackend::EVDEV;
+    default:
+        return JoystickBackend::AUTO;
+    }
+}
+
+void MainWindow::SyncJoystickList()
+{
+    std::vector<JoystickDescription> list = JoystickFactory::getJoysticks(SelectedBackend());
+    SyncJoystickCombo(ui->cmbJoystick, list, CoarseJoystick);
+    SyncJoystickCombo(ui->cmbFineJoystick, list, FineJoystick);
+}
+
+void MainWindow::SyncJoystickCombo(QComboBox *combo, const std::vector<JoystickDescription>& list,
+                                   JoystickRole role)
+{
+    // Changing the selection here would reopen the joystick
+    QSignalBlocker blocker(combo);
+
+    // Entries without a path, like "None", always stay
+    for (int i = combo->count() - 1; i >= 0; i--) {
+        std::string path = combo->itemData(i).toString().toStdString();
+        if (!path.empty() &&
+            std::none_of(list.begin(), list.end(),
+                         [&path](const JoystickDescription& desc) { return desc.filename == path; })) {
+            combo->removeItem(i);
+        }
+    }
+
+    if (role == FineJoystick && combo->findData(QString()) < 0) {
+        combo->insertItem(0, "None", QString());
+    }
+
+    for (const auto& desc : list) {
+        QString path = QString::fromStdString(desc.filename);
+        if (combo->findData(path) < 0) {
+            combo->addItem(JoystickEntry(desc), path);
+        }
+    }
+
+    const Joystick* joystick = joysticks[role].joystick.get();
+    if (joystick) {
+        int index = combo->findData(QString::fromStdString(joystick->getFilename()));
+        if (index >= 0) {
+            combo->setCurrentIndex(index);
+        }
+    } else if (role == FineJoystick && !joysticks[role].reconnectTimer->isActive()) {
+        combo->setCurrentIndex(combo->findData(QString()));
+    }
+}
+
+void MainWindow::OnInputDeviceAdded(const QString& devnode)
+{
+    for (int role = 0; role < JoystickRoleCount; role++) {
+        if (joysticks[role].reconnectTimer->isActive() && TryReconnect(static_cast<JoystickRole>(role), devnode)) {
+            return;
+        }
+    }
+
+    // Pick up a joystick plugged in while none is open, otherwise only list it
+    const JoystickSlot& coarse = joysticks[CoarseJoystick];
+    if (!coarse.joystick && !coarse.reconnectTimer->isActive()) {
+        JoystickRefreshClicked();
+    } else {
+        SyncJoystickList();
+    }
+}
+
+void MainWindow::OnInputDeviceRemoved(const QString& devnode)
+{
+    // udev may report the removal before a read on the device fails
+    for (int role = 0; role < JoystickRoleCount; role++) {
+        const Joystick* joystick = joysticks[role].joystick.get();
+        if (joystick && devnode == QString::fromStdString(joystick->getFilename())) {
+            BeginReconnect(static_cast<JoystickRole>(role), "device removed");
+        }
+    }
+
+    SyncJoystickList();
+}
+
+void MainWindow::OnJoystickLost(const QString& filename, const QString& error)
+{
+    for (int role = 0; role < JoystickRoleCount; role++) {
+        const Joystick* joystick = joysticks[role].joystick.get();
+        if (joystick && filename == QString::fromStdString(joystick->getFilename())) {
+            BeginReconnect(static_cast<JoystickRole>(role), error);
+        }
+    }
+}
+
+void MainWindow::BeginReconnect(JoystickRole role, const QString& reason)
+{
+    JoystickSlot& slot = joysticks[role];
+
+    // Hold the input before it goes away
+    controlThread->holdInput(role);
+
+    // Mapping and calibration live in the joystick object or the device,
+    // the replugged device starts from its defaults
+    slot.reconnectNode = slot.joystick->getFilename();
+    slot.reconnectName = slot.joystick->getName();
+    try {
+        slot.reconnectAxisMapping = slot.joystick->getAxisMapping();
+        slot.reconnectCalibration = slot.joystick->getCalibration();
+    } catch (const std::exception&) {
+        // Joydev keeps both in the kernel, gone with the device
+        slot.reconnectAxisMapping.clear();
+        slot.reconnectCalibration.clear();
+    }
+
+    CloseJoystick(role);
+    if (role == CoarseJoystick) {
+        ui->btnJoystickCalibrate->setEnabled(false);
+    }
+
+    // Without a key the device cannot be recognized when it comes back
+    if (slot.key.empty()) {
+        ui->lblStatus->setText(QString("%1 disconnected: %2").arg(RoleName(role)).arg(reason));
+        ForgetJoystick(role);
+        return;
+    }
+
+    slot.reconnectClock.start();
+    slot.reconnectTimer->start(ReconnectTimeout);
+    UpdateJoystickLabel();
+    ui->lblStatus->setText(QString("%1 lost (%2), holding its input").arg(RoleName(role)).arg(reason));
+}
+
+bool MainWindow::TryReconnect(JoystickRole role, const QString& devnode)
+{
+    JoystickSlot& slot = joysticks[role];
+
+    InputDeviceInfo info;
+    if (!InputDeviceIndex::instance().findByNode(devnode.toStdString(), info) ||
+        info.stableKey() != slot.key) {
+        return false;
+    }
+
+    // Reopen the same kind of node as before, its event or js node
+    bool joydev = slot.reconnectNode.compare(0, 13, "/dev/input/js") == 0;
+    if ((joydev ? info.joydev : info.evdev) != devnode.toStdString()) {
+        return false;
+    }
+
+    try {
+        slot.joystick = JoystickFactory::createJoystick(devnode.toStdString(), slot.backend);
+    } catch (const std::exception& e) {
+        qWarning() << "Failed to reopen joystick:" << e.what();
+        return false;
+    }
+
+    // Restore what the device lost, as far as it still fits
+    try {
+        if ((int)slot.reconnectAxisMapping.size() == slot.joystick->getAxisCount()) {
+            slot.joystick->setAxisMapping(slot.reconnectAxisMapping);
+        }
+        if ((int)slot.reconnectCalibration.size() == slot.joystick->getAxisCount()) {
+            slot.joystick->setCalibration(slot.reconnectCalibration);
+        }
+    } catch (const std::exception& e) {
+        qWarning() << "Failed to restore joystick settings:" << e.what();
+    }
+
+    // The loop holds the input until the new device reports
+    slot.reconnectTimer->stop();
+    AttachJoystick(role);
+    SyncJoystickList();
+
+    ui->lblStatus->setText(QString("%1 reconnected after %2 ms")
+                           .arg(RoleName(role))
+                           .arg(slot.reconnectClock.elapsed()));
+    return true;
+}
+
+void MainWindow::CancelReconnect(JoystickRole role)
+{
+    JoystickSlot& slot = joysticks[role];
+    if (slot.reconnectTimer->isActive()) {
+        slot.reconnectTimer->stop();
+        controlThread->releaseInput(role);
+    }
+}
+
+void MainWindow::OnReconnectTimeout(JoystickRole role)
+{
+    ui->lblStatus->setText(QString("%1 disconnected: %2 did not come back within %3 ms")
+                           .arg(RoleName(role))
+                           .arg(joysticks[role].reconnectName)
+                           .arg(ReconnectTimeout));
+    ForgetJoystick(role);
+}
+
+void MainWindow::ForgetJoystick(JoystickRole role)
+{
+    // Give up holding, the input reads as zero like without a joystick
+    controlThread->releaseInput(role);
+    joysticks[role].key.clear();
+
+    if (role == CoarseJoystick) {
+        JoystickRefreshClicked();
+    } else {
+        QSignalBlocker blocker(ui->cmbFineJoystick);
+        ui->cmbFineJoystick->setCurrentIndex(ui->cmbFineJoystick->findData(QString()));
+        ui->cmbFineXAxis->clear();
+        ui->cmbFineYAxis->clear();
+    }
+    UpdateJoystickLabel();
+}
+
 void MainWindow::OnBackendSelectionChanged(int index)
 {
     // Update joystick list with the new backend
@@ -817,6 +1406,7 @@ void MainWindow::OnXAxisMappingChanged(int index)
 {
     if (index >= 0 && index < ui->cmbXAxis->count()) {
         xAxisMapping = ui->cmbXAxis->itemData(index).toInt();
+        UpdateControlSettings();
     }
 }
 
@@ -824,6 +1414,7 @@ void MainWindow::OnYAxisMappingChanged(int index)
 {
     if (index >= 0 && index < ui->cmbYAxis->count()) {
         yAxisMapping = ui->cmbYAxis->itemData(index).toInt();
+        UpdateControlSettings();
     }
 }
 
@@ -831,6 +1422,7 @@ void MainWindow::OnXChannelChanged(int index)
 {
     if (index >= 0 && index < ui->cmbXChannel->count()) {
         xChannelMapping = ui->cmbXChannel->itemData(index).toInt();
+        UpdateControlSettings();
     }
 }
 
@@ -838,27 +1430,32 @@ void MainWindow::OnYChannelChanged(int index)
 {
     if (index >= 0 && index < ui->cmbYChannel->count()) {
         yChannelMapping = ui->cmbYChannel->itemData(index).toInt();
+        UpdateControlSettings();
     }
 }
 
 void MainWindow::OnInvertXChanged(bool checked)
 {
     invertX = checked;
+    UpdateControlSettings();
 }
 
 void MainWindow::OnInvertYChanged(bool checked)
 {
     invertY = checked;
+    UpdateControlSettings();
 }
 
 void MainWindow::OnXScaleChanged(double value)
 {
     xScale = value;
+    UpdateControlSettings();
 }
 
 void MainWindow::OnYScaleChanged(double value)
 {
     yScale = value;
+    UpdateControlSettings();
 }
 
 void MainWindow::OnDeadzoneChanged(double value)
@@ -867,6 +1464,29 @@ void MainWindow::OnDeadzoneChanged(double value)
     if (joystickWidget) {
         joystickWidget->setDeadzone(value);
     }
+    UpdateControlSettings();
+}
+
+void MainWindow::OnFineXAxisMappingChanged(int index)
+{
+    if (index >= 0 && index < ui->cmbFineXAxis->count()) {
+        fineXAxisMapping = ui->cmbFineXAxis->itemData(index).toInt();
+        UpdateControlSettings();
+    }
+}
+
+void MainWindow::OnFineYAxisMappingChanged(int index)
+{
+    if (index >= 0 && index < ui->cmbFineYAxis->count()) {
+        fineYAxisMapping = ui->cmbFineYAxis->itemData(index).toInt();
+        UpdateControlSettings();
+    }
+}
+
+void MainWindow::OnFineGainChanged(double value)
+{
+    fineGain = value;
+    UpdateControlSettings();
 }
 
 void MainWindow::CheckError(ErrorCode errorCode)
@@ -886,99 +1506,53 @@ void MainWindow::RefreshJoystickList()
     JoystickRefreshClicked();
 }
 
-void MainWindow::ApplyDeadzone(double &x, double &y)
+void MainWindow::UpdateControlSettings()
 {
-    // Calculate distance from center
-    double distance = sqrt(x * x + y * y);
-
-    if (distance < deadzone) {
-        // Inside deadzone - set to zero
-        x = 0.0;
-        y = 0.0;
-    } else {
-        // Outside deadzone - rescale to remove discontinuity
-        double factor = (distance - deadzone) / (1.0 - deadzone);
-        x = x * factor / distance;
-        y = y * factor / distance;
-    }
+    ControlSettings settings;
+    settings.xChannel = xChannelMapping;
+    settings.yChannel = yChannelMapping;
+    settings.inputs[CoarseJoystick].xAxis = xAxisMapping;
+    settings.inputs[CoarseJoystick].yAxis = yAxisMapping;
+    settings.inputs[CoarseJoystick].gain = 1.0;
+    settings.inputs[FineJoystick].xAxis = fineXAxisMapping;
+    settings.inputs[FineJoystick].yAxis = fineYAxisMapping;
+    settings.inputs[FineJoystick].gain = fineGain;
+    settings.invertX = invertX;
+    settings.invertY = invertY;
+    settings.xScale = xScale;
+    settings.yScale = yScale;
+    settings.deadzone = deadzone;
+    settings.xFilter = configure.xFilter;
+    settings.yFilter = configure.yFilter;
+
+    controlThread->setSettings(settings);
 }
 
-void MainWindow::UpdateMirrorPosition(double x, double y)
+void MainWindow::StartControlLoop()
 {
-    // Convert normalized values (-1 to 1) to voltage range
-    Array<ValueRange>* valueRanges = instantAoCtrl->getChannelRanges();
-    ValueRange range = valueRanges->getItem(0);
-
-    double minV = 0.0;
-    double maxV = 0.0;
-    double midV = 0.0;
-
-    // Extract min and max from the range
-    switch (range) {
-        case V_Neg10To10:
-            minV = -10.0;
-            maxV = 10.0;
-            break;
-        case V_Neg5To5:
-            minV = -5.0;
-            maxV = 5.0;
-            break;
-        case V_0To10:
-            minV = 0.0;
-            maxV = 10.0;
-            break;
-        default:
-            minV = -10.0;
-            maxV = 10.0;
-            break;
-    }
-
-    // Calculate midpoint
-    midV = (maxV + minV) / 2.0;
-
-    // Convert normalized values to voltage
-    double xVolts = midV + x * (maxV - midV);
-    double yVolts = midV + y * (maxV - midV);
-
-    // Clamp to valid range
-    if (xVolts < minV) xVolts = minV;
-    if (xVolts > maxV) xVolts = maxV;
-    if (yVolts < minV) yVolts = minV;
-    if (yVolts > maxV) yVolts = maxV;
-
-    // Set data array based on channel mapping
-    if (xChannelMapping - aoChannelStart >= 0 && xChannelMapping - aoChannelStart < aoChannelCount) {
-        aoData[xChannelMapping - aoChannelStart] = xVolts;
-    }
-
-    if (yChannelMapping - aoChannelStart >= 0 && yChannelMapping - aoChannelStart < aoChannelCount) {
-        aoData[yChannelMapping - aoChannelStart] = yVolts;
-    }
-
-    // Write to the DAQ
-    ErrorCode errorCode = instantAoCtrl->Write(aoChannelStart, aoChannelCount, aoData);
-    if (BioFailed(errorCode)) {
-        CheckError(errorCode);
+    // The loop only runs when there is an AO device or stream to drive
+    if (!aoStream && (configure.aoDeviceName.isEmpty() || !instantAoCtrl)) {
+        return;
     }
 
-    // Update voltage labels
-    ui->lblXVoltage->setText(QString("X Voltage: %.2fV").arg(xVolts));
-    ui->lblYVoltage->setText(QString("Y Voltage: %.2fV").arg(yVolts));
-
-    // Update graph with mirror position
-    if (graph) {
-        // Add point to the position trace (channel 0 for X, channel 1 for Y)
-        static double time = 0.0;
-        time += 0.02; // 20ms per timer tick
-
-        // If time exceeds the display window, reset
-        if (time > 10.0) {
-            graph->Clear();
-            time = 0.0;
-        }
+    controlThread->setAoCtrl(instantAoCtrl, aoTransform);
+    controlThread->setAoStream(aoStream.get());
+    controlThread->setRate(configure.controlRate);
+    controlThread->setRealtime(configure.realtimeControl);
+    controlThread->setOutputMode(configure.outputMode == "Event-driven" ? ControlThread::EventDriven
+                                                                       : ControlThread::Periodic,
+                                 configure.minWriteInterval);
+    UpdateControlSettings();
+
+    controlThread->clearTelemetry();
+    graphTimeOrigin = 0.0;
+    controlThread->start(QThread::TimeCriticalPriority);
+}
 
-        graph->AddPoint(0, time, xVolts);
-        graph->AddPoint(1, time, yVolts);
+void MainWindow::StopControlLoop()
+{
+    if (controlThread) {
+        controlThread->stop();
     }
 }
 
@@ -990,11 +1564,21 @@ void BDAQCALL MainWindow::OnDataReadyEvent(void *sender, BfdAiEventArgs *args, v
     // Get data from the device
     if (mainWindow && mainWindow->waveformAiCtrl) {
         mainWindow->waveformAiCtrl->GetData(args->Count, mainWindow->scaledData);
+        int channelCount = mainWindow->waveformAiCtrl->getConversion()->getChannelCount();
+
+        // The control loop records the newest mirror readback with every command
+        int frames = channelCount > 0 ? args->Count / channelCount : 0;
+        if (frames > 0 && mainWindow->controlThread) {
+            const double* last = mainWindow->scaledData + (frames - 1) * channelCount;
+            int xIndex = mainWindow->aiMirrorXIndex;
+            int yIndex = mainWindow->aiMirrorYIndex;
+            mainWindow->controlThread->publishMeasurement(xIndex >= 0 ? last[xIndex] : std::nan(""),
+                                                          yIndex >= 0 ? last[yIndex] : std::nan(""));
+        }
 
         // Update graph with the acquired data
         if (mainWindow->graph) {
-            int channelCount = mainWindow->waveformAiCtrl->getConversion()->getChannelCount();
-            mainWindow->graph->Chart(mainWindow->scaledData, channelCount, args->Count / channelCount, mainWindow->xInc);
+            mainWindow->graph->Chart(mainWindow->scaledData, channelCount, frames, mainWindow->xInc);
         }
     }
 }
@@ -1030,6 +1614,12 @@ void BDAQCALL MainWindow::OnStoppedEvent(void *sender, BfdAiEventArgs *args, voi
     MainWindow* mainWindow = (MainWindow*)userParam;
 
     if (mainWindow) {
+        // No more samples arrive, stop recording the last one. Published
+        // here rather than on the GUI thread to keep a single writer.
+        if (mainWindow->controlThread) {
+            mainWindow->controlThread->publishMeasurement(std::nan(""), std::nan(""));
+        }
+
         QMetaObject::invokeMethod(mainWindow, [mainWindow]() {
             mainWindow->ui->lblStatus->setText("Status: AI Acquisition Stopped");
             mainWindow->ui->lblStatus->setStyleSheet("color: black");
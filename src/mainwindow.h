@@ -1,21 +1,31 @@
 #ifndef MAINWINDOW_H
 #define MAINWINDOW_H
 
+#include <QElapsedTimer>
 #include <QMainWindow>
 #include <QTimer>
 #include <QVector>
 #include <memory>
+#include <vector>
 
 // Advantech DAQ headers
 #include "../../inc/bdaqctrl.h"
 using namespace Automation::BDaq;
 
+#include "ao_transform.h"
+#include "control_thread.h"
+#include "input_reactor.h"
+#include "joystick_factory.h"
+
 // Forward declarations
 class QButtonGroup;
+class QComboBox;
 class SimpleGraph;
 class Joystick;
 class ConfigureDialog;
 class AxisWidget;
+class RudderWidget;
+class ThrottleWidget;
 
 namespace Ui {
 class MainWindow;
@@ -46,20 +56,31 @@ private slots:
     // Joystick related slots
     void JoystickRefreshClicked();
     void JoystickCalibrateClicked();
-    void OnJoystickAxisChanged(int number, int value);
-    void OnJoystickButtonChanged(int number, bool value);
     
-    // Timer tick for updating outputs
+    // Timer tick for refreshing the GUI from the control loop
     void TimerTicked();
+
+    // Control loop related slots
+    void OnAoWriteFailed(int errorCode);
+
+    // Input thread related slots
+    void OnInputDeviceAdded(const QString& devnode);
+    void OnInputDeviceRemoved(const QString& devnode);
+    void OnJoystickLost(const QString& filename, const QString& error);
     
     // Menu actions
     void OnMenuExit();
     void OnMenuConfigure();
     void OnMenuJoystickTest();
+    void OnMenuSaveLatency();
     void OnMenuAbout();
     
     // Settings changes
     void OnJoystickSelectionChanged(int index);
+    void OnFineJoystickSelectionChanged(int index);
+    void OnFineXAxisMappingChanged(int index);
+    void OnFineYAxisMappingChanged(int index);
+    void OnFineGainChanged(double value);
     void OnBackendSelectionChanged(int index);
     void OnXAxisMappingChanged(int index);
     void OnYAxisMappingChanged(int index);
@@ -72,19 +93,63 @@ private slots:
     void OnDeadzoneChanged(double value);
 
 private:
+    // Joysticks mixed by the control loop, each drives the input of the same number
+    enum JoystickRole {
+        CoarseJoystick,     // Slews the mirror, selected in cmbJoystick
+        FineJoystick,       // Optional, trims it with a small gain
+        JoystickRoleCount
+    };
+    static_assert(JoystickRoleCount <= ControlSettings::MaxInputs, "one control input per joystick role");
+
+    // An open joystick and what is needed to reopen it after a replug
+    struct JoystickSlot {
+        std::unique_ptr<Joystick> joystick;  // Publishes its state to the control loop
+        JoystickBackend backend;             // Backend it was opened with
+        std::string key;                     // Stable key of its device, empty if unknown
+        QTimer *reconnectTimer;              // Running while waiting for the device
+        QElapsedTimer reconnectClock;        // Time since the joystick was lost
+        std::string reconnectNode;           // Device node it was opened on
+        QString reconnectName;               // Name it reported
+        std::vector<int> reconnectAxisMapping;                      // Restored on the new device
+        std::vector<Joystick::CalibrationData> reconnectCalibration;
+        bool filtersAdapted;                 // Filter defaults were fitted to its report rate
+
+        JoystickSlot() : backend(JoystickBackend::AUTO), reconnectTimer(nullptr), filtersAdapted(false) {}
+    };
+
     // Helper methods
     void ConfigureDevice();
     void ConfigureAI();
     void ConfigureAO();
+    void ConfigureAOStream();
     void ConfigureGraph();
     void UpdateAxisValues();
     void SetXCord();
     void CheckError(ErrorCode errorCode);
     void RefreshJoystickList();
     void ConnectJoystick(int index);
+    void OpenJoystick(JoystickRole role, const std::string& path);
+    void CloseJoystick(JoystickRole role);
+    void AttachJoystick(JoystickRole role);
+    void UpdateJoystickLabel();
+    void AdaptFilterDefaults();
+    void SyncJoystickList();
+    void SyncJoystickCombo(QComboBox *combo, const std::vector<JoystickDescription>& list, JoystickRole role);
+    void FillAxisCombos(QComboBox *xCombo, QComboBox *yCombo, int axisCount);
+    JoystickBackend SelectedBackend() const;
+    void BeginReconnect(JoystickRole role, const QString& reason);
+    bool TryReconnect(JoystickRole role, const QString& devnode);
+    void CancelReconnect(JoystickRole role);
+    void OnReconnectTimeout(JoystickRole role);
+    void ForgetJoystick(JoystickRole role);
+    static QString RoleName(JoystickRole role);
+    void StartInputReactor();
+    InputReactor::Backend InputBackendFromConfig() const;
     void UpdateUI();
-    void ApplyDeadzone(double &x, double &y);
-    void UpdateMirrorPosition(double x, double y);
+    void UpdateControlSettings();
+    void StartControlLoop();
+    void StopControlLoop();
+    void UpdateLatencyPanel();
     
     // Static callbacks for Advantech AI events
     static void BDAQCALL OnDataReadyEvent(void *sender, BfdAiEventArgs *args, void *userParam);
@@ -103,24 +168,38 @@ private:
     int rawDataBufferLength;
     TimeUnit timeUnit;
     double xInc;
+    int aiMirrorXIndex;              // Offset of the mirror X readback in an AI frame, -1 for none
+    int aiMirrorYIndex;              // Offset of the mirror Y readback in an AI frame, -1 for none
     SimpleGraph *graph;
     
     // AO related members
     InstantAoCtrl *instantAoCtrl;
     int aoChannelStart;
     int aoChannelCount;
-    double aoData[2];  // Data for analog output channels
+    AoTransform aoTransform;         // Per-channel volt transform handed to the control loop
+    std::unique_ptr<AoStream> aoStream;  // Hardware-paced output, null for instant writes
+    
+    // Control loop driving the mirror
+    ControlThread *controlThread;
+    std::vector<ControlSnapshot> telemetryBatch;  // Ticks drained from the control loop per refresh
+    double graphTimeOrigin;          // Control loop time at the left edge of the graph
+    int latencyRefreshCount;         // GUI ticks since the latency panel was refreshed
+    int meterRefreshCount;           // GUI ticks since the report meters were shown
     
     // Joystick related members
-    std::unique_ptr<Joystick> joystick;
-    QVector<double> joystickAxes;    // Normalized values (-1.0 to 1.0)
-    QVector<bool> joystickButtons;   // Button states
-    double xAxisValue;               // Current X axis value
-    double yAxisValue;               // Current Y axis value
+    InputReactor *inputReactor;          // Reads the joystick off the GUI thread
+    JoystickSlot joysticks[JoystickRoleCount];
+    AxisFilterConfig filterDefaults;     // Filter settings last fitted to a device, replaced until edited
+
+    // A lost joystick is reconnected while the control loop holds its input
+    static const int ReconnectTimeout = 3000;    // Milliseconds before giving up
     
     // Mapping settings
     int xAxisMapping;                // Which joystick axis maps to X output
     int yAxisMapping;                // Which joystick axis maps to Y output
+    int fineXAxisMapping;            // Which fine joystick axis trims X
+    int fineYAxisMapping;            // Which fine joystick axis trims Y
+    double fineGain;                 // Weight of the fine joystick against the coarse one
     int xChannelMapping;             // Which AO channel for X
     int yChannelMapping;             // Which AO channel for Y
     bool invertX;                    // Whether to invert X axis
@@ -129,11 +208,13 @@ private:
     double yScale;                   // Scaling factor for Y
     double deadzone;                 // Deadzone radius
     
-    // Timer for regular updates
+    // Timer for GUI refresh
     QTimer *timer;
     
     // Custom widgets
     AxisWidget *joystickWidget;      // Widget showing joystick position
+    RudderWidget *rudderWidget;      // Widget showing rudder position
+    ThrottleWidget *throttleWidget;  // Widget showing throttle position
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,163 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "simulated_ao_device.h"
+
+#include <cmath>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+SimulatedAoDevice::SimulatedAoDevice()
+    : m_running(false),
+      m_channelCount(0),
+      m_chunkSamples(0),
+      m_chunkPeriod(0),
+      m_queued(0),
+      m_writeChunk(0),
+      m_playChunk(0),
+      m_maxStep(0.0),
+      m_hasPlayed(false),
+      m_samplesPlayed(0)
+{
+}
+
+SimulatedAoDevice::~SimulatedAoDevice()
+{
+    stop();
+}
+
+ErrorCode SimulatedAoDevice::prepare(int channelStart, int channelCount, int rate, int chunkSamples)
+{
+    (void)channelStart;
+
+    if (m_running.load() || channelCount <= 0 || rate <= 0 || chunkSamples <= 0) {
+        return ErrorFuncBusy;
+    }
+
+    std::lock_guard<std::mutex> locker(m_mutex);
+    m_channelCount = channelCount;
+    m_chunkSamples = chunkSamples;
+    m_chunkPeriod = static_cast<int64_t>(chunkSamples) * 1000000000LL / rate;
+    m_buffer.assign(static_cast<size_t>(chunkSamples) * channelCount * 2, 0.0);
+    m_lastSamples.assign(channelCount, 0.0);
+    m_queued = 0;
+    m_writeChunk = 0;
+    m_playChunk = 0;
+    m_maxStep = 0.0;
+    m_hasPlayed = false;
+    m_samplesPlayed.store(0);
+
+    resetChunks(2);
+    return Success;
+}
+
+ErrorCode SimulatedAoDevice::start()
+{
+    if (m_running.load() || m_chunkPeriod == 0) {
+        return ErrorFuncBusy;
+    }
+
+    m_running.store(true);
+    m_thread = std::thread(&SimulatedAoDevice::play, this);
+    return Success;
+}
+
+void SimulatedAoDevice::stop()
+{
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+ErrorCode SimulatedAoDevice::writeChunk(const double* data)
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    if (m_queued >= 2) {
+        return ErrorFuncBusy;
+    }
+
+    size_t length = static_cast<size_t>(m_chunkSamples) * m_channelCount;
+    memcpy(&m_buffer[m_writeChunk * length], data, length * sizeof(double));
+    m_writeChunk ^= 1;
+    m_queued++;
+
+    chunkWritten();
+    return Success;
+}
+
+double SimulatedAoDevice::maxStep() const
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return m_maxStep;
+}
+
+double SimulatedAoDevice::lastSample(int channel) const
+{
+    std::lock_guard<std::mutex> locker(m_mutex);
+    return (channel >= 0 && channel < m_channelCount) ? m_lastSamples[channel] : 0.0;
+}
+
+void SimulatedAoDevice::play()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t next = static_cast<int64_t>(now.tv_sec) * 1000000000LL + now.tv_nsec;
+
+    while (m_running.load()) {
+        // One chunk leaves the "DAC" per chunk period
+        next += m_chunkPeriod;
+        struct timespec wakeup;
+        wakeup.tv_sec = next / 1000000000LL;
+        wakeup.tv_nsec = next % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr) == EINTR) {
+        }
+
+        bool played = false;
+        {
+            std::lock_guard<std::mutex> locker(m_mutex);
+            if (m_queued == 0) {
+                // The output holds its last value, like the hardware does
+                underrun();
+            } else {
+                size_t length = static_cast<size_t>(m_chunkSamples) * m_channelCount;
+                const double* chunk = &m_buffer[m_playChunk * length];
+
+                for (int i = 0; i < m_chunkSamples; i++) {
+                    for (int ch = 0; ch < m_channelCount; ch++) {
+                        double sample = chunk[i * m_channelCount + ch];
+                        if (m_hasPlayed) {
+                            m_maxStep = std::fmax(m_maxStep, std::fabs(sample - m_lastSamples[ch]));
+                        }
+                        m_lastSamples[ch] = sample;
+                    }
+                    m_hasPlayed = true;
+                }
+
+                m_playChunk ^= 1;
+                m_queued--;
+                m_samplesPlayed.fetch_add(m_chunkSamples, std::memory_order_relaxed);
+                played = true;
+            }
+        }
+
+        if (played) {
+            chunkTransmitted();
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SIMULATED_AO_DEVICE_H
+#define SIMULATED_AO_DEVICE_H
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "buffered_ao_device.h"
+
+/**
+ * Stand-in for a buffered AO device
+ *
+ * A thread consumes one chunk per chunk period on CLOCK_MONOTONIC, the way
+ * the hardware clock would, and records statistics about the waveform it
+ * "plays". Lets the streaming engine run without an Advantech device.
+ */
+class SimulatedAoDevice : public BufferedAoDevice
+{
+public:
+    SimulatedAoDevice();
+    ~SimulatedAoDevice() override;
+
+    ErrorCode prepare(int channelStart, int channelCount, int rate, int chunkSamples) override;
+    ErrorCode start() override;
+    void stop() override;
+    ErrorCode writeChunk(const double* data) override;
+
+    // Samples per channel played so far
+    uint64_t samplesPlayed() const { return m_samplesPlayed.load(std::memory_order_relaxed); }
+
+    // Largest change between two consecutive samples on any channel, in volts
+    double maxStep() const;
+
+    // Last sample played on a channel (index relative to the first channel)
+    double lastSample(int channel) const;
+
+private:
+    void play();
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    mutable std::mutex m_mutex;
+
+    int m_channelCount;
+    int m_chunkSamples;
+    int64_t m_chunkPeriod;          // Nanoseconds
+    std::vector<double> m_buffer;   // Two chunks
+    int m_queued;                   // Chunks written and not yet played
+    int m_writeChunk;
+    int m_playChunk;
+
+    std::vector<double> m_lastSamples;
+    double m_maxStep;
+    bool m_hasPlayed;
+    std::atomic<uint64_t> m_samplesPlayed;
+};
+
+#endif // SIMULATED_AO_DEVICE_H
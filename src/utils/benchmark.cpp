@@ -0,0 +1,719 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/benchmark.h"
+
+#include <cmath>
+#include <errno.h>
+#include <fcntl.h>
+#include <atomic>
+#include <iomanip>
+#include <memory>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include <linux/joystick.h>
+
+#include "ao_stream.h"
+#include "filter_pipeline.h"
+#include "joystick.h"
+#include "simulated_ao_device.h"
+#include "utils/io_uring.h"
+#include "utils/latency_histogram.h"
+
+static const int BenchmarkSamples = 4000000;
+static const double PredictionSeconds = 60.0;
+static const double StreamingSeconds = 2.0;
+static const int InputEvents = 200000;
+static const double WakeupSeconds = 1.0;
+static const int WakeupReportRate = 1000;
+
+static int64_t monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Relative jitter applied to the sample spacing of the test signal
+static const double BenchmarkJitter = 0.1;
+
+struct TestSignal {
+    std::vector<double> value;
+    std::vector<double> dt;
+};
+
+// Noisy stick movement sampled with jittery timing, generated up front so
+// only the filter is measured
+static TestSignal makeTestSignal(double sampleRate)
+{
+    TestSignal signal;
+    signal.value.resize(BenchmarkSamples);
+    signal.dt.resize(BenchmarkSamples);
+
+    srand(1);
+    double t = 0.0;
+    for (int i = 0; i < BenchmarkSamples; i++) {
+        double jitter = (rand() / static_cast<double>(RAND_MAX) - 0.5) * 2.0 * BenchmarkJitter;
+        signal.dt[i] = (1.0 + jitter) / sampleRate;
+        t += signal.dt[i];
+
+        double noise = (rand() / static_cast<double>(RAND_MAX) - 0.5) * 0.02;
+        signal.value[i] = 0.8 * std::sin(2.0 * M_PI * 0.5 * t) + noise;
+    }
+    return signal;
+}
+
+// Where the operator points during the prediction benchmark
+static inline double trackingTarget(double t)
+{
+    return 0.6 * std::sin(2.0 * M_PI * 0.7 * t) + 0.3 * std::sin(2.0 * M_PI * 1.9 * t);
+}
+
+static double runPipeline(FilterPipeline& pipeline, const TestSignal& signal)
+{
+    // Accumulate the output so the compiler cannot drop the work
+    volatile double sink = 0.0;
+    double sum = 0.0;
+
+    int64_t start = monotonicNs();
+    for (size_t i = 0; i < signal.value.size(); i++) {
+        sum += pipeline.process(signal.value[i], signal.dt[i]);
+    }
+    int64_t elapsed = monotonicNs() - start;
+
+    sink = sum;
+    (void)sink;
+    return static_cast<double>(elapsed) / signal.value.size();
+}
+
+static void reportPipeline(std::ostream& out, const char* name, FilterPipeline& pipeline,
+                           const TestSignal& signal, double sampleRate)
+{
+    double ns = runPipeline(pipeline, signal);
+
+    // Share of one control period spent filtering one axis
+    double budget = 100.0 * ns / (1e9 / sampleRate);
+
+    out << std::left << std::setw(20) << name
+        << std::right << std::setw(10) << std::fixed << std::setprecision(2) << ns << " ns"
+        << std::setw(12) << std::setprecision(4) << budget << " %" << std::endl;
+}
+
+// Largest deviation of the low-pass from a constant input, with the time
+// steps of a loop holding a slower stick or of a jittery loop
+static double constantInputDeviation(double cutoff, double sampleRate, bool heldReports)
+{
+    AxisFilterConfig config;
+    config.smoothingCutoff = 0.0;
+    config.lowpassCutoff = cutoff;
+
+    FilterPipeline pipeline;
+    pipeline.configure(config, sampleRate);
+    pipeline.reset(1.0);
+
+    srand(3);
+    double deviation = 0.0;
+    for (int i = 0; i < BenchmarkSamples / 10; i++) {
+        double random = rand() / static_cast<double>(RAND_MAX);
+        double dt;
+        if (heldReports) {
+            // filterTimeStep() for a 125 Hz stick: seven loop periods, then
+            // what remains of the report interval
+            dt = (i % 8 != 7) ? 1.0 / sampleRate : 1e-6 + random * (1.0 / sampleRate - 1e-6);
+        } else {
+            dt = (0.1 + random * 1.9) / sampleRate;
+        }
+        deviation = std::fmax(deviation, std::fabs(pipeline.process(1.0, dt) - 1.0));
+    }
+    return deviation;
+}
+
+void benchmarkFilters(std::ostream& out, double sampleRate)
+{
+    TestSignal signal = makeTestSignal(sampleRate);
+
+    out << "Filter stage cost per sample (" << BenchmarkSamples << " samples, "
+        << sampleRate << " Hz period budget, " << BenchmarkJitter * 100.0
+        << " % timing jitter)" << std::endl;
+    out << std::left << std::setw(20) << "Stage"
+        << std::right << std::setw(13) << "Time" << std::setw(14) << "Budget" << std::endl;
+
+    // Each stage on its own
+    for (int type = FilterPipeline::Deadzone; type <= FilterPipeline::Slew; type++) {
+        AxisFilterConfig config;
+        config.smoothingCutoff = 0.0;
+
+        switch (type) {
+            case FilterPipeline::Deadzone:
+                config.deadzone = 0.05;
+                break;
+            case FilterPipeline::Predict:
+                config.predictionMode = ConstantAcceleration;
+                break;
+            case FilterPipeline::Expo:
+                config.expo = 0.3;
+                break;
+            case FilterPipeline::OneEuro:
+                config.smoothingCutoff = 1.0;
+                config.smoothingBeta = 0.05;
+                break;
+            case FilterPipeline::Biquad:
+                config.lowpassCutoff = 20.0;
+                break;
+            case FilterPipeline::Slew:
+                config.slewRate = 2.0;
+                break;
+        }
+
+        FilterPipeline pipeline;
+        pipeline.configure(config, sampleRate);
+        reportPipeline(out, FilterPipeline::stageName(static_cast<FilterPipeline::StageType>(type)),
+                       pipeline, signal, sampleRate);
+    }
+
+    // The chain used by default, and every stage at once
+    FilterPipeline defaultPipeline;
+    defaultPipeline.configure(AxisFilterConfig(), sampleRate);
+    reportPipeline(out, "Default pipeline", defaultPipeline, signal, sampleRate);
+
+    AxisFilterConfig full;
+    full.deadzone = 0.05;
+    full.expo = 0.3;
+    full.smoothingBeta = 0.05;
+    full.lowpassCutoff = 20.0;
+    full.slewRate = 2.0;
+    full.predictionMode = ConstantAcceleration;
+
+    FilterPipeline fullPipeline;
+    fullPipeline.configure(full, sampleRate);
+    reportPipeline(out, "All stages", fullPipeline, signal, sampleRate);
+
+    // A still stick must leave the mirror still, whatever the time steps
+    out << std::endl << "Low-pass deviation from a constant input" << std::endl;
+    out << std::left << std::setw(20) << "Cutoff"
+        << std::right << std::setw(16) << "Held reports" << std::setw(16) << "Jittery loop" << std::endl;
+
+    const double cutoffs[] = { 10.0, 30.0, 100.0, 200.0 };
+    for (double cutoff : cutoffs) {
+        double held = constantInputDeviation(cutoff, sampleRate, true);
+        double jittery = constantInputDeviation(cutoff, sampleRate, false);
+        bool steady = held < 1e-9 && jittery < 1e-9;
+
+        out << std::left << std::setw(20) << (std::to_string(static_cast<int>(cutoff)) + " Hz")
+            << std::right << std::scientific << std::setprecision(2)
+            << std::setw(16) << held << std::setw(16) << jittery
+            << (steady ? "" : "  UNSTEADY") << std::fixed << std::endl;
+    }
+}
+
+// Tracking error of one filter configuration in the simulated loop
+static double trackingError(const AxisFilterConfig& config, double sampleRate, double reportRate,
+                            double latency)
+{
+    const int samples = static_cast<int>(PredictionSeconds * sampleRate);
+    const int delay = static_cast<int>(latency * sampleRate + 0.5);
+    const double dt = 1.0 / sampleRate;
+
+    FilterPipeline pipeline;
+    pipeline.configure(config, sampleRate);
+
+    std::vector<double> command(samples);
+    srand(2);
+    double held = 0.0;
+    double nextReport = 0.0;
+    for (int i = 0; i < samples; i++) {
+        double t = i * dt;
+
+        // The stick reports at its own rate, quantized like a 16-bit axis;
+        // the loop holds the last report in between
+        if (t >= nextReport) {
+            double noise = (rand() / static_cast<double>(RAND_MAX) - 0.5) * 0.004;
+            held = std::round((trackingTarget(t) + noise) * 32767.0) / 32767.0;
+            nextReport += 1.0 / reportRate;
+        }
+
+        command[i] = pipeline.process(held, dt);
+    }
+
+    // The mirror follows the command after the system latency; the error
+    // is measured against where the operator was pointing at that time
+    double sum = 0.0;
+    int count = 0;
+    for (int i = delay + static_cast<int>(sampleRate); i < samples; i++) {
+        double error = command[i - delay] - trackingTarget(i * dt);
+        sum += error * error;
+        count++;
+    }
+
+    return std::sqrt(sum / count);
+}
+
+void benchmarkPrediction(std::ostream& out, double sampleRate, double latency)
+{
+    const double reportRate = 125.0;
+
+    out << std::defaultfloat << "Tracking error with " << latency * 1000.0 << " ms system latency ("
+        << sampleRate << " Hz loop, " << reportRate << " Hz stick reports)" << std::endl;
+    out << std::left << std::setw(32) << "Configuration"
+        << std::right << std::setw(14) << "RMS error" << std::endl;
+
+    AxisFilterConfig plain;
+    plain.smoothingCutoff = 0.0;
+
+    AxisFilterConfig velocity = plain;
+    velocity.predictionMode = ConstantVelocity;
+    velocity.predictionHorizon = latency;
+
+    AxisFilterConfig acceleration = velocity;
+    acceleration.predictionMode = ConstantAcceleration;
+
+    AxisFilterConfig smoothed;
+
+    AxisFilterConfig smoothedVelocity = smoothed;
+    smoothedVelocity.predictionMode = ConstantVelocity;
+    smoothedVelocity.predictionHorizon = latency;
+
+    struct {
+        const char* name;
+        const AxisFilterConfig& config;
+    } cases[] = {
+        { "Plain", plain },
+        { "Constant velocity prediction", velocity },
+        { "Constant accel. prediction", acceleration },
+        { "Default smoothing", smoothed },
+        { "Smoothing + velocity pred.", smoothedVelocity },
+    };
+
+    for (const auto& c : cases) {
+        out << std::left << std::setw(32) << c.name
+            << std::right << std::setw(14) << std::fixed << std::setprecision(5)
+            << trackingError(c.config, sampleRate, reportRate, latency) << std::endl;
+    }
+}
+
+// Runs the command path against the simulated buffered AO device in real time
+static void runStream(std::ostream& out, const char* name, AoStream::Interpolation interpolation,
+                      int controlRate, int streamRate)
+{
+    const double reportRate = 125.0;
+    const int64_t period = 1000000000LL / controlRate;
+
+    SimulatedAoDevice* device = new SimulatedAoDevice();
+    AoStream stream{std::unique_ptr<BufferedAoDevice>(device)};
+
+    AoTransform transform;
+    transform.configure(V_Neg10To10, 0, 1);
+
+    // Refill every 5 ms
+    ErrorCode errorCode = stream.configure(transform, streamRate, streamRate / 200, interpolation, controlRate);
+    if (BioFailed(errorCode)) {
+        out << name << ": failed to configure the stream" << std::endl;
+        return;
+    }
+
+    const int64_t start = monotonicNs();
+    double volts = 10.0 * trackingTarget(0.0);
+    errorCode = stream.start(start, &volts);
+    if (BioFailed(errorCode)) {
+        out << name << ": failed to start the stream" << std::endl;
+        return;
+    }
+
+    int64_t deadline = start;
+    double nextReport = 0.0;
+    while (deadline - start < static_cast<int64_t>(StreamingSeconds * 1e9)) {
+        deadline += period;
+        struct timespec wakeup;
+        wakeup.tv_sec = deadline / 1000000000LL;
+        wakeup.tv_nsec = deadline % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr) == EINTR) {
+        }
+
+        // The stick reports at its own rate, the loop holds the last report
+        int64_t now = monotonicNs();
+        double t = (now - start) * 1e-9;
+        if (t >= nextReport) {
+            volts = 10.0 * trackingTarget(t);
+            nextReport += 1.0 / reportRate;
+        }
+
+        stream.pushCommand(now, &volts);
+        stream.refill(now);
+    }
+
+    stream.stop();
+
+    out << std::left << std::setw(20) << name << std::right
+        << std::setw(12) << std::fixed << std::setprecision(4) << device->maxStep()
+        << std::setw(12) << device->samplesPlayed()
+        << std::setw(12) << stream.underruns()
+        << std::setw(10) << stream.resyncs()
+        << std::setw(10) << std::setprecision(1) << stream.getLag() / 1e6 << std::endl;
+}
+
+void benchmarkStreaming(std::ostream& out, int controlRate, int streamRate)
+{
+    const double reportRate = 125.0;
+
+    out << std::defaultfloat << "AO output on the simulated device (" << controlRate << " Hz loop, "
+        << streamRate << " S/s, " << reportRate << " Hz stick reports, "
+        << StreamingSeconds << " s)" << std::endl;
+    out << std::left << std::setw(20) << "Output" << std::right
+        << std::setw(12) << "Max step V" << std::setw(12) << "Samples"
+        << std::setw(12) << "Underruns" << std::setw(10) << "Resyncs" << std::setw(10) << "Lag ms" << std::endl;
+
+    // A software-timed write holds each report until the next one, the step
+    // between reports is what the mirror driver sees
+    double maxStep = 0.0;
+    double previous = 10.0 * trackingTarget(0.0);
+    for (double t = 1.0 / reportRate; t < StreamingSeconds; t += 1.0 / reportRate) {
+        double volts = 10.0 * trackingTarget(t);
+        maxStep = std::fmax(maxStep, std::fabs(volts - previous));
+        previous = volts;
+    }
+    out << std::left << std::setw(20) << "Instant (staircase)" << std::right
+        << std::setw(12) << std::fixed << std::setprecision(4) << maxStep << std::endl;
+
+    runStream(out, "Stream, linear", AoStream::Linear, controlRate, streamRate);
+    runStream(out, "Stream, cubic", AoStream::Cubic, controlRate, streamRate);
+}
+
+// Drains a non-blocking fd the way Joystick::update() does, with up to
+// batchSize events per read(), and counts the read() calls
+static int drainEvents(int fd, struct js_event* events, int batchSize, uint64_t& syscalls)
+{
+    int total = 0;
+    while (true) {
+        ssize_t len = read(fd, events, batchSize * sizeof(struct js_event));
+        syscalls++;
+        if (len <= 0) {
+            break;
+        }
+
+        int count = len / sizeof(struct js_event);
+        total += count;
+        if (batchSize > 1 && count < batchSize) {
+            break;
+        }
+    }
+    return total;
+}
+
+static void runInputReads(std::ostream& out, const char* name, int batchSize, int eventsPerWakeup)
+{
+    int fds[2];
+    if (pipe2(fds, O_NONBLOCK) < 0) {
+        out << name << ": failed to create a pipe" << std::endl;
+        return;
+    }
+
+    std::vector<struct js_event> wakeup(eventsPerWakeup);
+    for (int i = 0; i < eventsPerWakeup; i++) {
+        wakeup[i].time = i;
+        wakeup[i].value = i;
+        wakeup[i].type = JS_EVENT_AXIS;
+        wakeup[i].number = i % 2;
+    }
+
+    std::vector<struct js_event> events(batchSize);
+    uint64_t syscalls = 0;
+    int64_t elapsed = 0;
+    int received = 0;
+
+    // The writes stand in for the device and are not timed
+    while (received < InputEvents) {
+        if (write(fds[1], wakeup.data(), wakeup.size() * sizeof(struct js_event)) < 0) {
+            break;
+        }
+
+        int64_t start = monotonicNs();
+        received += drainEvents(fds[0], events.data(), batchSize, syscalls);
+        elapsed += monotonicNs() - start;
+    }
+
+    close(fds[0]);
+    close(fds[1]);
+
+    out << std::left << std::setw(24) << name << std::right
+        << std::setw(10) << eventsPerWakeup
+        << std::setw(18) << std::fixed << std::setprecision(1) << 1000.0 * syscalls / received
+        << std::setw(14) << std::setprecision(1) << static_cast<double>(elapsed) / received << std::endl;
+}
+
+void benchmarkInputReads(std::ostream& out)
+{
+    out << std::defaultfloat << "Joystick reads through a pipe (" << InputEvents << " js_event records)" << std::endl;
+    out << std::left << std::setw(24) << "Read" << std::right
+        << std::setw(10) << "Events" << std::setw(18) << "Syscalls/1000 ev"
+        << std::setw(14) << "ns/event" << std::endl;
+
+    // Two moving axes per wakeup is a fast stick, 16 a burst after a stall
+    const int wakeupSizes[] = { 1, 2, 16 };
+    for (int eventsPerWakeup : wakeupSizes) {
+        runInputReads(out, "One event per read", 1, eventsPerWakeup);
+        runInputReads(out, "Batched read", Joystick::ReadBatchSize, eventsPerWakeup);
+    }
+}
+
+static int64_t threadCpuNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+}
+
+// Simulated sticks writing two axis events per report into pipes, and what
+// the reader measured
+struct WakeupRun {
+    int devices;
+    int reports;                                // Reports per device
+    std::vector<int> readFds;
+    std::vector<int> writeFds;
+    int stopFd;
+    std::unique_ptr<std::atomic<int64_t>[]> sendTimes;  // Per device and report
+
+    LatencyHistogram latency;                   // Write of a report to its read
+    uint64_t events;
+    uint64_t wakeups;
+    int64_t cpuNs;                              // Reader thread CPU time
+
+    WakeupRun(int devices_, int reports_) :
+        devices(devices_),
+        reports(reports_),
+        stopFd(-1),
+        sendTimes(new std::atomic<int64_t>[devices_ * reports_]),
+        events(0),
+        wakeups(0),
+        cpuNs(0)
+    {}
+};
+
+// Drains one device the way Joystick::update() does and records the
+// latency of each report, identified by the time field of its first event
+static void drainReports(WakeupRun& run, int device)
+{
+    struct js_event events[Joystick::ReadBatchSize];
+
+    while (true) {
+        ssize_t len = read(run.readFds[device], events, sizeof(events));
+        if (len <= 0) {
+            break;
+        }
+
+        int64_t now = monotonicNs();
+        int count = len / sizeof(struct js_event);
+        for (int i = 0; i < count; i++) {
+            if (events[i].number == 0 && events[i].time < (uint32_t)run.reports) {
+                int64_t sent = run.sendTimes[device * run.reports + events[i].time].load(std::memory_order_relaxed);
+                run.latency.record(now - sent);
+            }
+        }
+        run.events += count;
+
+        if (count < Joystick::ReadBatchSize) {
+            break;
+        }
+    }
+}
+
+static void readEpoll(WakeupRun& run)
+{
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    for (int i = 0; i <= run.devices; i++) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLET;
+        event.data.u64 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, i < run.devices ? run.readFds[i] : run.stopFd, &event);
+    }
+
+    const int64_t cpuStart = threadCpuNs();
+    struct epoll_event events[16];
+    bool stopping = false;
+
+    while (!stopping) {
+        int count = epoll_wait(epollFd, events, 16, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        run.wakeups++;
+        for (int i = 0; i < count; i++) {
+            int device = events[i].data.u64;
+            if (device == run.devices) {
+                stopping = true;
+            } else {
+                drainReports(run, device);
+            }
+        }
+    }
+
+    run.cpuNs = threadCpuNs() - cpuStart;
+    close(epollFd);
+}
+
+static void readIoUring(WakeupRun& run, IoUring& ring)
+{
+    bool multishot = true;
+    std::vector<bool> arm(run.devices + 1, true);
+
+    const int64_t cpuStart = threadCpuNs();
+    bool stopping = false;
+
+    while (!stopping) {
+        for (int i = 0; i <= run.devices; i++) {
+            if (arm[i]) {
+                arm[i] = !ring.pollAdd(i < run.devices ? run.readFds[i] : run.stopFd, POLLIN, i, multishot);
+            }
+        }
+
+        if (ring.submitAndWait(1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        run.wakeups++;
+        ring.reap([&](const struct io_uring_cqe& cqe) {
+            int device = cqe.user_data;
+            if (cqe.res == -EINVAL && multishot) {
+                multishot = false;
+            } else if (device == run.devices) {
+                stopping = true;
+            } else if (cqe.res > 0) {
+                drainReports(run, device);
+            }
+
+            if (!(cqe.flags & IORING_CQE_F_MORE)) {
+                arm[device] = true;
+            }
+        });
+    }
+
+    run.cpuNs = threadCpuNs() - cpuStart;
+}
+
+static void runInputWakeups(std::ostream& out, bool ioUring, int devices)
+{
+    const char* name = ioUring ? "io_uring multishot poll" : "epoll, edge-triggered";
+    const int reports = static_cast<int>(WakeupSeconds * WakeupReportRate);
+    WakeupRun run(devices, reports);
+
+    IoUring ring;
+    if (ioUring && !ring.initialize(64)) {
+        out << std::left << std::setw(26) << name << std::right << std::setw(9) << devices
+            << "  not available: " << strerror(errno) << std::endl;
+        return;
+    }
+
+    for (int i = 0; i < devices; i++) {
+        int fds[2];
+        if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0) {
+            out << name << ": failed to create a pipe" << std::endl;
+            return;
+        }
+        run.readFds.push_back(fds[0]);
+        run.writeFds.push_back(fds[1]);
+    }
+    run.stopFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    std::thread reader([&]() {
+        if (ioUring) {
+            readIoUring(run, ring);
+        } else {
+            readEpoll(run);
+        }
+    });
+
+    // Every stick reports at the same fixed rate, the writes stand in for the devices
+    const int64_t period = 1000000000LL / WakeupReportRate;
+    int64_t deadline = monotonicNs() + 10000000LL;
+    for (int report = 0; report < reports; report++) {
+        struct timespec wakeup;
+        wakeup.tv_sec = deadline / 1000000000LL;
+        wakeup.tv_nsec = deadline % 1000000000LL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, nullptr) == EINTR) {
+        }
+
+        for (int i = 0; i < devices; i++) {
+            struct js_event events[2];
+            for (int axis = 0; axis < 2; axis++) {
+                events[axis].time = report;
+                events[axis].value = report;
+                events[axis].type = JS_EVENT_AXIS;
+                events[axis].number = axis;
+            }
+
+            run.sendTimes[i * reports + report].store(monotonicNs(), std::memory_order_relaxed);
+            ssize_t len = write(run.writeFds[i], events, sizeof(events));
+            (void)len;
+        }
+        deadline += period;
+    }
+
+    // Let the reader catch up before it is stopped
+    usleep(10000);
+    uint64_t one = 1;
+    ssize_t len = write(run.stopFd, &one, sizeof(one));
+    (void)len;
+    reader.join();
+
+    for (int i = 0; i < devices; i++) {
+        close(run.readFds[i]);
+        close(run.writeFds[i]);
+    }
+    close(run.stopFd);
+
+    double events = run.events > 0 ? static_cast<double>(run.events) : 1.0;
+    out << std::left << std::setw(26) << name << std::right
+        << std::setw(9) << devices
+        << std::setw(10) << run.events
+        << std::setw(14) << std::fixed << std::setprecision(1) << 1000.0 * run.wakeups / events
+        << std::setw(12) << std::setprecision(0) << run.cpuNs / events
+        << std::setw(10) << std::setprecision(1) << run.latency.percentile(50) / 1000.0
+        << std::setw(10) << run.latency.percentile(99) / 1000.0
+        << std::setw(10) << run.latency.max() / 1000.0 << std::endl;
+}
+
+void benchmarkInputWakeups(std::ostream& out)
+{
+    out << std::defaultfloat << "Input thread wakeups, sticks reporting two axes at "
+        << WakeupReportRate << " Hz through pipes for " << WakeupSeconds << " s" << std::endl;
+    out << std::left << std::setw(26) << "Wait" << std::right
+        << std::setw(9) << "Devices" << std::setw(10) << "Events"
+        << std::setw(14) << "Wakeups/1000" << std::setw(12) << "CPU ns/ev"
+        << std::setw(10) << "p50 us" << std::setw(10) << "p99 us" << std::setw(10) << "max us" << std::endl;
+
+    const int deviceCounts[] = { 1, 4 };
+    for (int devices : deviceCounts) {
+        runInputWakeups(out, false, devices);
+        runInputWakeups(out, true, devices);
+    }
+}
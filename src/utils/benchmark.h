@@ -0,0 +1,68 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <ostream>
+
+/**
+ * Measure the cost of each filter stage and of the default pipeline
+ *
+ * @param out Stream the results are written to
+ * @param sampleRate Control rate the filters are configured for in Hz
+ */
+void benchmarkFilters(std::ostream& out, double sampleRate = 1000.0);
+
+/**
+ * Compare the tracking error of the plain and predictive command paths
+ * against a simulated operator, with the mirror lagging the command
+ *
+ * @param out Stream the results are written to
+ * @param sampleRate Control rate in Hz
+ * @param latency System latency the mirror adds, in seconds
+ */
+void benchmarkPrediction(std::ostream& out, double sampleRate = 1000.0, double latency = 0.02);
+
+/**
+ * Run the streaming AO engine against the simulated device in real time and
+ * compare the smoothness of its output with software-timed writes
+ *
+ * @param out Stream the results are written to
+ * @param controlRate Control loop rate in Hz
+ * @param streamRate AO sample rate in Hz
+ */
+void benchmarkStreaming(std::ostream& out, int controlRate = 1000, int streamRate = 50000);
+
+/**
+ * Count the read() calls and time needed to drain joystick events, one
+ * event per call against the batched reads of Joystick::update()
+ *
+ * @param out Stream the results are written to
+ */
+void benchmarkInputReads(std::ostream& out);
+
+/**
+ * Compare the input thread waiting on epoll and on io_uring, with simulated
+ * sticks writing reports into pipes: wakeups and reader CPU time per event,
+ * and the latency from a write to its read
+ *
+ * @param out Stream the results are written to
+ */
+void benchmarkInputWakeups(std::ostream& out);
+
+#endif // BENCHMARK_H
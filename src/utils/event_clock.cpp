@@ -0,0 +1,102 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/event_clock.h"
+
+#include <algorithm>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/input.h>
+
+// Joydev event times are 32-bit milliseconds
+static const int64_t JiffiesPeriod = (1LL << 32) * 1000;
+
+static inline int64_t clockMicros(clockid_t clock)
+{
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+EventClock::EventClock(Source source)
+{
+    setSource(source);
+}
+
+bool EventClock::selectMonotonic(int fd)
+{
+    int clock = CLOCK_MONOTONIC;
+    bool selected = ioctl(fd, EVIOCSCLOCKID, &clock) == 0;
+    setSource(selected ? Monotonic : Realtime);
+    return selected;
+}
+
+void EventClock::setSource(Source source)
+{
+    m_source = source;
+    m_offset = 0;
+    m_windowOffset = 0;
+    m_windowStart = 0;
+    m_lastTime = 0;
+    m_wraps = 0;
+}
+
+int64_t EventClock::toMonotonic(int64_t time)
+{
+    switch (m_source) {
+    case Monotonic:
+        return time;
+
+    case Realtime:
+        return time - (clockMicros(CLOCK_REALTIME) - clockMicros(CLOCK_MONOTONIC));
+
+    case Jiffies:
+        break;
+    }
+
+    // Unwrap the millisecond counter, it wraps after about 49 days
+    if (m_windowStart != 0 && time < m_lastTime - JiffiesPeriod / 2) {
+        m_wraps += JiffiesPeriod;
+    }
+    m_lastTime = time;
+    time += m_wraps;
+
+    // The event happened before it was read, so the smallest read delay
+    // seen is the closest bound on the offset between the clocks
+    int64_t readTime = now();
+    int64_t offset = readTime - time;
+    if (m_windowStart == 0) {
+        m_offset = offset;
+        m_windowOffset = offset;
+        m_windowStart = readTime;
+    } else {
+        m_offset = std::min(m_offset, offset);
+        m_windowOffset = std::min(m_windowOffset, offset);
+        if (readTime - m_windowStart >= OffsetWindow) {
+            m_offset = m_windowOffset;
+            m_windowOffset = offset;
+            m_windowStart = readTime;
+        }
+    }
+
+    return time + m_offset;
+}
+
+int64_t EventClock::now()
+{
+    return clockMicros(CLOCK_MONOTONIC);
+}
@@ -0,0 +1,80 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EVENT_CLOCK_H
+#define EVENT_CLOCK_H
+
+#include <stdint.h>
+
+/**
+ * Converts the event times of one input device to CLOCK_MONOTONIC
+ *
+ * Event devices stamp events with CLOCK_REALTIME unless told otherwise,
+ * and joydev stamps them with a 32-bit millisecond tick counter. Moved to
+ * CLOCK_MONOTONIC, the time of a report can be compared to the times the
+ * control loop takes, so the latency from the device to the AO output is
+ * measured instead of estimated. Used by the thread reading the device.
+ */
+class EventClock
+{
+public:
+    // Clock the kernel stamps the events with
+    enum Source {
+        Monotonic,      // Event device after EVIOCSCLOCKID, passed through
+        Realtime,       // Event device default, shifted by the current offset
+        Jiffies         // Joydev milliseconds, mapped by the smallest read delay seen
+    };
+
+    // Read delays are taken over the last one to two windows, so the
+    // mapping follows slow drift of the tick counter
+    static const int64_t OffsetWindow = 10000000;  // Microseconds
+
+    explicit EventClock(Source source = Monotonic);
+
+    /**
+     * Switch an event device to CLOCK_MONOTONIC
+     * @param fd Event device fd
+     * @return Whether the kernel switched, the source is Realtime otherwise
+     */
+    bool selectMonotonic(int fd);
+
+    void setSource(Source source);
+    Source source() const { return m_source; }
+
+    /**
+     * Convert an event time
+     * @param time Event time in microseconds on the source clock
+     * @return CLOCK_MONOTONIC time in microseconds, never later than now
+     *         for Jiffies
+     */
+    int64_t toMonotonic(int64_t time);
+
+    /**
+     * Get the current CLOCK_MONOTONIC time in microseconds
+     */
+    static int64_t now();
+
+private:
+    Source m_source;
+    int64_t m_offset;           // Jiffies: smallest read delay of the last two windows
+    int64_t m_windowOffset;     // Jiffies: smallest read delay of the current window
+    int64_t m_windowStart;      // Jiffies: monotonic time the current window began, 0 before the first event
+    int64_t m_lastTime;         // Jiffies: last event time before unwrapping
+    int64_t m_wraps;            // Jiffies: time added for wraps of the 32-bit counter
+};
+
+#endif // EVENT_CLOCK_H
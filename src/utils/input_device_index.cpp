@@ -0,0 +1,201 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/input_device_index.h"
+#include "utils/evdev_helper.h"
+
+#include <QDir>
+#include <QFile>
+#include <QMutexLocker>
+#include <QStringList>
+#include <algorithm>
+#include <sys/sysmacros.h>
+#include <linux/input.h>
+
+static const char* SysClassInput = "/sys/class/input";
+
+static QString readAttribute(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+// sysfs prints capability bitmaps as hex longs, most significant first
+static std::vector<unsigned long> readBitmap(const QString& path)
+{
+    std::vector<unsigned long> bits;
+    QStringList words = readAttribute(path).split(' ');
+    for (int i = words.size() - 1; i >= 0; i--) {
+        if (!words[i].isEmpty()) {
+            bits.push_back(words[i].toULong(nullptr, 16));
+        }
+    }
+    return bits;
+}
+
+static int countBits(const std::vector<unsigned long>& bits, int first, int last)
+{
+    int count = 0;
+    for (int bit = first; bit < last; bit++) {
+        size_t word = BIT_WORD(bit);
+        if (word < bits.size() && (bits[word] & BIT_MASK(bit))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+// "major:minor" as found in the dev attribute of a device node
+static dev_t readDeviceNumber(const QString& path)
+{
+    QStringList parts = readAttribute(path).split(':');
+    if (parts.size() != 2) {
+        return 0;
+    }
+    return makedev(parts[0].toUInt(), parts[1].toUInt());
+}
+
+// Order input12 after input9
+static int nodeNumber(const QString& name, int prefix)
+{
+    return name.mid(prefix).toInt();
+}
+
+std::string InputDeviceInfo::stableKey() const
+{
+    QString key = QString("%1:%2:").arg(vendorId, 4, 16, QChar('0')).arg(productId, 4, 16, QChar('0'));
+    if (!uniq.empty()) {
+        return key.toStdString() + "uniq:" + uniq;
+    }
+    return key.toStdString() + "phys:" + phys;
+}
+
+InputDeviceIndex& InputDeviceIndex::instance()
+{
+    static InputDeviceIndex index;
+    return index;
+}
+
+InputDeviceIndex::InputDeviceIndex()
+    : m_stale(true),
+      m_caching(false),
+      m_generation(0),
+      m_scans(0)
+{
+}
+
+std::vector<InputDeviceInfo> InputDeviceIndex::devices()
+{
+    QMutexLocker locker(&m_mutex);
+    refresh();
+    return m_devices;
+}
+
+bool InputDeviceIndex::findByNode(const std::string& devnode, InputDeviceInfo& info)
+{
+    QMutexLocker locker(&m_mutex);
+    refresh();
+
+    auto it = m_byNode.find(devnode);
+    if (it == m_byNode.end()) {
+        return false;
+    }
+    info = m_devices[it->second];
+    return true;
+}
+
+bool InputDeviceIndex::findByNumber(dev_t number, InputDeviceInfo& info)
+{
+    QMutexLocker locker(&m_mutex);
+    refresh();
+
+    auto it = m_byNumber.find(number);
+    if (it == m_byNumber.end()) {
+        return false;
+    }
+    info = m_devices[it->second];
+    return true;
+}
+
+void InputDeviceIndex::refresh()
+{
+    // Clear the flag first, an event during the scan makes the next lookup rescan
+    if (m_stale.exchange(false, std::memory_order_acq_rel) || !m_caching.load(std::memory_order_relaxed)) {
+        scan();
+    }
+}
+
+void InputDeviceIndex::scan()
+{
+    m_devices.clear();
+    m_byNode.clear();
+    m_byNumber.clear();
+    m_scans.fetch_add(1, std::memory_order_relaxed);
+
+    QDir classDir(SysClassInput);
+    QStringList inputs = classDir.entryList(QStringList() << "input*", QDir::Dirs | QDir::NoDotAndDotDot);
+    std::sort(inputs.begin(), inputs.end(), [](const QString& a, const QString& b) {
+        return nodeNumber(a, 5) < nodeNumber(b, 5);
+    });
+
+    for (const QString& input : inputs) {
+        QString base = classDir.filePath(input);
+
+        InputDeviceInfo info;
+        info.sysname = input.toStdString();
+        info.name = readAttribute(base + "/name").toStdString();
+        info.vendorId = readAttribute(base + "/id/vendor").toInt(nullptr, 16);
+        info.productId = readAttribute(base + "/id/product").toInt(nullptr, 16);
+        info.uniq = readAttribute(base + "/uniq").toStdString();
+        info.phys = readAttribute(base + "/phys").toStdString();
+
+        std::vector<unsigned long> evbit = readBitmap(base + "/capabilities/ev");
+        std::vector<unsigned long> absbit = readBitmap(base + "/capabilities/abs");
+        std::vector<unsigned long> keybit = readBitmap(base + "/capabilities/key");
+
+        info.axisCount = countBits(absbit, 0, ABS_CNT);
+        info.buttonCount = countBits(keybit, BTN_MISC, KEY_CNT);
+        info.hasJoystickButtons = countBits(keybit, BTN_JOYSTICK, BTN_DIGI) > 0;
+        info.hasForceFeedback = countBits(evbit, EV_FF, EV_FF + 1) > 0;
+
+        // The device nodes are child devices of the input device
+        QStringList nodes = QDir(base).entryList(QStringList() << "js*" << "event*",
+                                                 QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString& node : nodes) {
+            std::string devnode = "/dev/input/" + node.toStdString();
+            dev_t number = readDeviceNumber(base + "/" + node + "/dev");
+
+            if (node.startsWith("js")) {
+                info.joydev = devnode;
+                info.joydevNumber = number;
+            } else {
+                info.evdev = devnode;
+                info.evdevNumber = number;
+            }
+
+            m_byNode[devnode] = m_devices.size();
+            if (number != 0) {
+                m_byNumber[number] = m_devices.size();
+            }
+        }
+
+        m_devices.push_back(info);
+    }
+}
@@ -0,0 +1,150 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INPUT_DEVICE_INDEX_H
+#define INPUT_DEVICE_INDEX_H
+
+#include <QMutex>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * One input device as described by sysfs, with its device nodes
+ */
+struct InputDeviceInfo {
+    std::string sysname;        // Parent input device, e.g. "input12"
+    std::string name;           // Device name, as EVIOCGNAME and JSIOCGNAME report it
+    int vendorId;
+    int productId;
+    std::string uniq;           // Serial number, empty for most sticks
+    std::string phys;           // Physical path, e.g. "usb-0000:00:14.0-2/input0"
+    std::string joydev;         // /dev/input/jsN, empty without joydev
+    std::string evdev;          // /dev/input/eventN, empty without evdev
+    dev_t joydevNumber;         // Device numbers of the nodes, 0 if absent
+    dev_t evdevNumber;
+    int axisCount;              // Absolute axes, as joydev and EvdevJoystick count them
+    int buttonCount;            // Buttons from BTN_MISC up, as joydev counts them
+    bool hasJoystickButtons;    // Any button from BTN_JOYSTICK below BTN_DIGI
+    bool hasForceFeedback;
+
+    InputDeviceInfo() :
+        vendorId(0),
+        productId(0),
+        joydevNumber(0),
+        evdevNumber(0),
+        axisCount(0),
+        buttonCount(0),
+        hasJoystickButtons(false),
+        hasForceFeedback(false)
+    {}
+
+    bool isJoystick() const { return axisCount > 0 && hasJoystickButtons; }
+
+    /**
+     * Get a key naming the same physical device across a replug, when its
+     * node numbers change. Built from vendor and product, and the serial
+     * number or, without one, the port the device is plugged into.
+     */
+    std::string stableKey() const;
+};
+
+/**
+ * Index of the input devices under /sys/class/input
+ *
+ * Built from sysfs attributes only, without opening any device node, and
+ * indexed by device node and device number. While caching is enabled the
+ * index is kept until invalidate() is called, which the input thread does
+ * on every udev input event. Safe to use from any thread.
+ */
+class InputDeviceIndex
+{
+public:
+    static InputDeviceIndex& instance();
+
+    /**
+     * Get all input devices, rescanning sysfs if the index is stale
+     * @return Devices in the order of their input device number
+     */
+    std::vector<InputDeviceInfo> devices();
+
+    /**
+     * Look up the device owning a device node
+     * @param devnode Device node, e.g. /dev/input/js0
+     * @param info Set to the device if found
+     * @return Whether the node belongs to a known device
+     */
+    bool findByNode(const std::string& devnode, InputDeviceInfo& info);
+
+    /**
+     * Look up the device owning a device number, e.g. st_rdev of an open fd
+     * @param number Device number of a js or event node
+     * @param info Set to the device if found
+     * @return Whether the number belongs to a known device
+     */
+    bool findByNumber(dev_t number, InputDeviceInfo& info);
+
+    /**
+     * Mark the index stale, the next lookup rescans
+     */
+    void invalidate()
+    {
+        m_generation.fetch_add(1, std::memory_order_relaxed);
+        m_stale.store(true, std::memory_order_release);
+    }
+
+    /**
+     * Get the number of invalidations, results derived from the index stay
+     * valid while it is unchanged and caching is enabled
+     */
+    uint64_t generation() const { return m_generation.load(std::memory_order_relaxed); }
+
+    /**
+     * Keep the index between lookups (only with something calling invalidate())
+     * @param enabled Whether to cache, otherwise every lookup rescans
+     */
+    void setCaching(bool enabled) { m_caching.store(enabled, std::memory_order_relaxed); }
+    bool caching() const { return m_caching.load(std::memory_order_relaxed); }
+
+    /**
+     * Get the number of sysfs scans done so far
+     */
+    uint64_t scanCount() const { return m_scans.load(std::memory_order_relaxed); }
+
+private:
+    InputDeviceIndex();
+
+    void refresh();
+    void scan();
+
+    QMutex m_mutex;
+    std::vector<InputDeviceInfo> m_devices;
+    std::map<std::string, size_t> m_byNode;
+    std::map<dev_t, size_t> m_byNumber;
+    std::atomic<bool> m_stale;
+    std::atomic<bool> m_caching;
+    std::atomic<uint64_t> m_generation;
+    std::atomic<uint64_t> m_scans;
+
+    InputDeviceIndex(const InputDeviceIndex&) = delete;
+    InputDeviceIndex& operator=(const InputDeviceIndex&) = delete;
+};
+
+#endif // INPUT_DEVICE_INDEX_H
@@ -0,0 +1,222 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/io_uring.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+IoUring::IoUring()
+    : m_fd(-1),
+      m_queued(0),
+      m_sqRing(MAP_FAILED),
+      m_cqRing(MAP_FAILED),
+      m_sqRingSize(0),
+      m_cqRingSize(0),
+      m_sqes(nullptr),
+      m_sqesSize(0),
+      m_sqHead(nullptr),
+      m_sqTail(nullptr),
+      m_sqMask(nullptr),
+      m_sqArray(nullptr),
+      m_sqEntries(0),
+      m_cqHead(nullptr),
+      m_cqTail(nullptr),
+      m_cqMask(nullptr),
+      m_cqes(nullptr)
+{
+}
+
+IoUring::~IoUring()
+{
+    release();
+}
+
+bool IoUring::initialize(unsigned entries)
+{
+    release();
+
+#ifdef __NR_io_uring_setup
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+
+    m_fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (m_fd < 0) {
+        return false;
+    }
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    // Newer kernels map both rings at once
+    bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (singleMmap) {
+        if (m_cqRingSize > m_sqRingSize) {
+            m_sqRingSize = m_cqRingSize;
+        }
+        m_cqRingSize = m_sqRingSize;
+    }
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_fd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED) {
+        int error = errno;
+        release();
+        errno = error;
+        return false;
+    }
+
+    if (singleMmap) {
+        m_cqRing = m_sqRing;
+    } else {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_fd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED) {
+            int error = errno;
+            release();
+            errno = error;
+            return false;
+        }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      m_fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        int error = errno;
+        release();
+        errno = error;
+        return false;
+    }
+    m_sqes = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(m_sqRing);
+    m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+
+    char* cq = static_cast<char*>(m_cqRing);
+    m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    return true;
+#else
+    (void)entries;
+    errno = ENOSYS;
+    return false;
+#endif
+}
+
+void IoUring::release()
+{
+    if (m_sqes) {
+        munmap(m_sqes, m_sqesSize);
+        m_sqes = nullptr;
+    }
+
+    if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+        munmap(m_cqRing, m_cqRingSize);
+    }
+    m_cqRing = MAP_FAILED;
+
+    if (m_sqRing != MAP_FAILED) {
+        munmap(m_sqRing, m_sqRingSize);
+        m_sqRing = MAP_FAILED;
+    }
+
+    if (m_fd >= 0) {
+        close(m_fd);
+        m_fd = -1;
+    }
+
+    m_queued = 0;
+}
+
+struct io_uring_sqe* IoUring::nextSqe()
+{
+    if (m_fd < 0) {
+        return nullptr;
+    }
+
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    unsigned tail = *m_sqTail + m_queued;
+    if (tail - head >= m_sqEntries) {
+        return nullptr;
+    }
+
+    unsigned index = tail & *m_sqMask;
+    struct io_uring_sqe* sqe = &m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    m_sqArray[index] = index;
+    m_queued++;
+    return sqe;
+}
+
+bool IoUring::pollAdd(int fd, uint32_t events, uint64_t userData, bool multishot)
+{
+    struct io_uring_sqe* sqe = nextSqe();
+    if (!sqe) {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = userData;
+    return true;
+}
+
+bool IoUring::pollRemove(uint64_t target, uint64_t userData)
+{
+    struct io_uring_sqe* sqe = nextSqe();
+    if (!sqe) {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = userData;
+    return true;
+}
+
+int IoUring::submitAndWait(unsigned minComplete)
+{
+#ifdef __NR_io_uring_enter
+    // The kernel sees the queued entries once the tail moves past them
+    unsigned toSubmit = m_queued;
+    if (toSubmit > 0) {
+        __atomic_store_n(m_sqTail, *m_sqTail + toSubmit, __ATOMIC_RELEASE);
+        m_queued = 0;
+    }
+
+    unsigned flags = minComplete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    return syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete, flags, nullptr, 0);
+#else
+    (void)minComplete;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
@@ -0,0 +1,129 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef IO_URING_H
+#define IO_URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/**
+ * Minimal io_uring instance for polling fds, on the raw system calls
+ *
+ * Only what the input thread needs: (multishot) poll requests and batched
+ * reaping of their completions. Needs no library, so a kernel without
+ * io_uring, or with it disabled, is found at runtime by initialize()
+ * failing. One thread submits and reaps.
+ */
+class IoUring
+{
+public:
+    IoUring();
+    ~IoUring();
+
+    /**
+     * Create the ring
+     * @param entries Submission queue size, rounded up by the kernel
+     * @return Whether io_uring is available, errno is set otherwise
+     */
+    bool initialize(unsigned entries);
+
+    /**
+     * Tear down the ring, outstanding requests are cancelled
+     */
+    void release();
+
+    bool isOpen() const { return m_fd >= 0; }
+
+    /**
+     * Queue a poll request, submitted by the next submitAndWait()
+     * @param fd File descriptor to poll
+     * @param events Poll events, e.g. POLLIN
+     * @param userData Returned with each completion
+     * @param multishot Keep posting completions until removed
+     * @return False when the submission queue is full
+     */
+    bool pollAdd(int fd, uint32_t events, uint64_t userData, bool multishot);
+
+    /**
+     * Queue the removal of a poll request
+     * @param target User data of the request to remove
+     * @param userData User data of the removal's own completion
+     * @return False when the submission queue is full
+     */
+    bool pollRemove(uint64_t target, uint64_t userData);
+
+    /**
+     * Submit queued requests and wait for completions
+     * @param minComplete Completions to wait for, 0 to only submit
+     * @return Number of requests submitted, or -1 with errno set
+     */
+    int submitAndWait(unsigned minComplete);
+
+    /**
+     * Hand every available completion to a handler and release them
+     * @param handler Called as handler(const io_uring_cqe&)
+     * @return Number of completions handled
+     */
+    template<typename Handler>
+    unsigned reap(Handler handler)
+    {
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        unsigned count = 0;
+
+        while (head != tail) {
+            handler(m_cqes[head & *m_cqMask]);
+            head++;
+            count++;
+
+            // Release each entry before the handler may queue new requests
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+        }
+        return count;
+    }
+
+private:
+    struct io_uring_sqe* nextSqe();
+
+    int m_fd;
+    unsigned m_queued;              // Entries filled in past the published tail
+
+    void* m_sqRing;
+    void* m_cqRing;
+    size_t m_sqRingSize;
+    size_t m_cqRingSize;
+    struct io_uring_sqe* m_sqes;
+    size_t m_sqesSize;
+
+    unsigned* m_sqHead;
+    unsigned* m_sqTail;
+    unsigned* m_sqMask;
+    unsigned* m_sqArray;
+    unsigned m_sqEntries;
+
+    unsigned* m_cqHead;
+    unsigned* m_cqTail;
+    unsigned* m_cqMask;
+    struct io_uring_cqe* m_cqes;
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+};
+
+#endif // IO_URING_H
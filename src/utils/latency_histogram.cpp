@@ -0,0 +1,123 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/latency_histogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+    reset();
+}
+
+int LatencyHistogram::bucketIndex(int64_t ns)
+{
+    uint64_t value = ns < 0 ? 0 : static_cast<uint64_t>(ns);
+
+    // Small values map one to one onto the first buckets
+    if (value < static_cast<uint64_t>(SubBuckets)) {
+        return static_cast<int>(value);
+    }
+
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > MaxExponent) {
+        return BucketCount - 1;
+    }
+
+    int shift = exponent - SubBucketBits;
+    int sub = static_cast<int>((value >> shift) & (SubBuckets - 1));
+    return (exponent - SubBucketBits + 1) * SubBuckets + sub;
+}
+
+int64_t LatencyHistogram::bucketLowerBound(int index)
+{
+    if (index < SubBuckets) {
+        return index;
+    }
+
+    int exponent = index / SubBuckets + SubBucketBits - 1;
+    int sub = index % SubBuckets;
+    return static_cast<int64_t>(SubBuckets + sub) << (exponent - SubBucketBits);
+}
+
+int64_t LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < SubBuckets) {
+        return index;
+    }
+
+    int exponent = index / SubBuckets + SubBucketBits - 1;
+    return bucketLowerBound(index) + (static_cast<int64_t>(1) << (exponent - SubBucketBits)) - 1;
+}
+
+void LatencyHistogram::record(int64_t ns)
+{
+    // Single writer: plain load/store pairs avoid locked read-modify-writes
+    std::atomic<uint64_t>& bucket = m_buckets[bucketIndex(ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    m_count.store(m_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (ns > m_max.load(std::memory_order_relaxed)) {
+        m_max.store(ns, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for (int i = 0; i < BucketCount; i++) {
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+int64_t LatencyHistogram::percentile(double percentile) const
+{
+    // Sum the buckets rather than trusting m_count, which may be ahead of them
+    uint64_t total = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        total += m_buckets[i].load(std::memory_order_relaxed);
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint64_t target = static_cast<uint64_t>(percentile / 100.0 * total + 0.5);
+    if (target < 1) target = 1;
+    if (target > total) target = total;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < BucketCount; i++) {
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if (seen >= target) {
+            // Never report more than the largest value actually recorded
+            int64_t upper = bucketUpperBound(i);
+            int64_t maximum = max();
+            return upper < maximum ? upper : maximum;
+        }
+    }
+
+    return max();
+}
+
+void LatencyHistogram::writeBuckets(std::ostream& out) const
+{
+    for (int i = 0; i < BucketCount; i++) {
+        uint64_t count = m_buckets[i].load(std::memory_order_relaxed);
+        if (count > 0) {
+            out << bucketLowerBound(i) << " " << bucketUpperBound(i) << " " << count << "\n";
+        }
+    }
+}
@@ -0,0 +1,81 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+
+/**
+ * Fixed-size log-linear histogram of durations in nanoseconds
+ *
+ * Values are grouped by power of two, each split into SubBuckets linear
+ * bins, so every recorded value is kept to within about 6 % from
+ * nanoseconds up to minutes. Recording is a handful of integer
+ * operations and never allocates. One thread records; any thread may
+ * read, seeing a slightly stale but usable view.
+ */
+class LatencyHistogram
+{
+public:
+    static const int SubBucketBits = 4;
+    static const int SubBuckets = 1 << SubBucketBits;
+    static const int MaxExponent = 40;      // Values up to about 18 minutes
+    static const int BucketCount = (MaxExponent - SubBucketBits + 2) * SubBuckets;
+
+    LatencyHistogram();
+
+    /**
+     * Record one duration (recording thread only)
+     * @param ns Duration in nanoseconds, negative values count as zero
+     */
+    void record(int64_t ns);
+
+    /**
+     * Clear all counts (recording thread only, or while it is stopped)
+     */
+    void reset();
+
+    /**
+     * Value below which the given share of samples fall
+     * @param percentile Percentile from 0 to 100
+     * @return Upper bound of the matching bucket in nanoseconds, 0 when empty
+     */
+    int64_t percentile(double percentile) const;
+
+    uint64_t count() const { return m_count.load(std::memory_order_relaxed); }
+    int64_t max() const { return m_max.load(std::memory_order_relaxed); }
+
+    /**
+     * Write the non-empty buckets as "lower upper count" lines
+     * @param out Destination stream
+     */
+    void writeBuckets(std::ostream& out) const;
+
+private:
+    static int bucketIndex(int64_t ns);
+    static int64_t bucketLowerBound(int index);
+    static int64_t bucketUpperBound(int index);
+
+    std::atomic<uint64_t> m_buckets[BucketCount];
+    std::atomic<uint64_t> m_count;
+    std::atomic<int64_t> m_max;
+};
+
+#endif // LATENCY_HISTOGRAM_H
@@ -51,7 +51,8 @@ LibinputHelper* LibinputHelper::instance()
 LibinputHelper::LibinputHelper()
     : m_udev(nullptr),
       m_libinput(nullptr),
-      m_notifier(nullptr)
+      m_notifier(nullptr),
+      m_wakeups(0)
 {
 }
 
@@ -73,8 +74,9 @@ bool LibinputHelper::initialize()
         return false;
     }
 
-    // Initialize libinput
-    m_libinput = libinput_udev_create_context(&interface, nullptr, m_udev);
+    // One path context for all devices, they are added as they are found or
+    // opened rather than taking over the whole seat
+    m_libinput = libinput_path_create_context(&interface, nullptr);
     if (!m_libinput) {
         qWarning() << "Failed to initialize libinput";
         udev_unref(m_udev);
@@ -82,16 +84,6 @@ bool LibinputHelper::initialize()
         return false;
     }
 
-    // Set up libinput to monitor all input devices
-    if (libinput_udev_assign_seat(m_libinput, "seat0") != 0) {
-        qWarning() << "Failed to assign seat to libinput context";
-        libinput_unref(m_libinput);
-        m_libinput = nullptr;
-        udev_unref(m_udev);
-        m_udev = nullptr;
-        return false;
-    }
-
     // Get libinput file descriptor for monitoring
     int fd = libinput_get_fd(m_libinput);
     
@@ -114,6 +106,11 @@ void LibinputHelper::shutdown()
         m_notifier = nullptr;
     }
 
+    for (auto it = m_devices.begin(); it != m_devices.end(); ++it) {
+        libinput_device_unref(it.key());
+    }
+    m_devices.clear();
+
     if (m_libinput) {
         libinput_unref(m_libinput);
         m_libinput = nullptr;
@@ -127,18 +124,79 @@ void LibinputHelper::shutdown()
     m_callbacks.clear();
 }
 
+libinput_device* LibinputHelper::addDevice(const QString& devnode, DeviceListener* listener)
+{
+    if (!m_libinput && !initialize())
+        return nullptr;
+
+    // Devices found by enumeration are already in the context, do not probe twice
+    for (auto it = m_devices.begin(); it != m_devices.end(); ++it) {
+        if (it.value().devnode == devnode) {
+            if (listener) {
+                it.value().listener = listener;
+            }
+            return it.key();
+        }
+    }
+
+    libinput_device* device = libinput_path_add_device(m_libinput, devnode.toUtf8().constData());
+    if (!device)
+        return nullptr;
+
+    DeviceEntry entry;
+    entry.devnode = devnode;
+    entry.listener = listener;
+    entry.events = 0;
+    m_devices.insert(libinput_device_ref(device), entry);
+    return device;
+}
+
+void LibinputHelper::removeDevice(libinput_device* device)
+{
+    auto it = m_devices.find(device);
+    if (it == m_devices.end())
+        return;
+
+    m_devices.erase(it);
+    libinput_path_remove_device(device);
+    libinput_device_unref(device);
+}
+
+quint64 LibinputHelper::eventCount(libinput_device* device) const
+{
+    auto it = m_devices.find(device);
+    return it == m_devices.end() ? 0 : it.value().events;
+}
+
 void LibinputHelper::handleLibinputEvents()
 {
     if (!m_libinput)
         return;
 
     // Process events while they're available
+    m_wakeups++;
     libinput_dispatch(m_libinput);
     
     // Process pending events
     struct libinput_event *event;
     while ((event = libinput_get_event(m_libinput)) != nullptr) {
         enum libinput_event_type type = libinput_event_get_type(event);
+
+        // Hand the event to the owner of its device
+        auto it = m_devices.find(libinput_event_get_device(event));
+        if (it != m_devices.end()) {
+            it.value().events++;
+            if (it.value().listener) {
+                it.value().listener->libinputEvent(event);
+            }
+
+            // The device is gone from the context, drop our reference
+            if (type == LIBINPUT_EVENT_DEVICE_REMOVED) {
+                libinput_device* device = it.key();
+                m_devices.erase(it);
+                libinput_device_unref(device);
+            }
+        }
         
         // Handle device added/removed events
         if (type == LIBINPUT_EVENT_DEVICE_ADDED || type == LIBINPUT_EVENT_DEVICE_REMOVED) {
@@ -451,8 +509,8 @@ QVector<LibinputHelper::DeviceInfo> LibinputHelper::findInputDevices(const QStri
         
         const char* devnode = udev_device_get_devnode(dev);
         if (devnode) {
-            // Try to add this device to our libinput instance
-            libinput_device* libinput_dev = libinput_path_add_device(m_libinput, devnode);
+            // Try to add this device to the shared context
+            libinput_device* libinput_dev = addDevice(QString::fromUtf8(devnode), nullptr);
             if (libinput_dev) {
                 // Check if it's the type of device we're looking for
                 if (type.isEmpty() || isDeviceOfType(libinput_dev, type)) {
@@ -460,7 +518,7 @@ QVector<LibinputHelper::DeviceInfo> LibinputHelper::findInputDevices(const QStri
                     devices.append(info);
                 }
                 
-                // We don't remove the device from libinput context to keep it available for events
+                // The device stays in the shared context, a joystick opened later reuses it
             }
         }
         
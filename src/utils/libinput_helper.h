@@ -31,8 +31,16 @@
 // Forward declarations to avoid including libinput headers in our header
 struct libinput;
 struct libinput_device;
+struct libinput_event;
 struct udev;
 
+/**
+ * Shared libinput path context for all devices opened by the application
+ *
+ * Devices are added once and stay in the context, so every joystick shares
+ * one libinput fd and one socket notifier. Events are handed to the
+ * listener registered for their libinput_device.
+ */
 class LibinputHelper : public QObject {
     Q_OBJECT
 
@@ -50,6 +58,19 @@ public:
         int buttonCount;
     };
 
+    // Receives the events of one device from the shared context
+    class DeviceListener {
+    public:
+        virtual ~DeviceListener() {}
+
+        /**
+         * Called for every event of the device, including
+         * LIBINPUT_EVENT_DEVICE_REMOVED after which the device is gone
+         * @param event Event, destroyed after the call
+         */
+        virtual void libinputEvent(libinput_event* event) = 0;
+    };
+
     // Singleton access
     static LibinputHelper* instance();
 
@@ -71,6 +92,34 @@ public:
     // Register for device hotplug notifications
     void registerDeviceCallback(std::function<void(bool added, const DeviceInfo&)> callback);
 
+    /**
+     * Add a device to the shared context, or reuse it if it was added before
+     * @param devnode Event device node
+     * @param listener Receiver of the device events, or nullptr
+     * @return Device, or nullptr if libinput could not open it
+     */
+    libinput_device* addDevice(const QString& devnode, DeviceListener* listener);
+
+    /**
+     * Detach the listener of a device and remove the device from the context
+     * @param device Device returned by addDevice()
+     */
+    void removeDevice(libinput_device* device);
+
+    /**
+     * Get the number of libinput events dispatched for a device
+     * @param device Device returned by addDevice()
+     */
+    quint64 eventCount(libinput_device* device) const;
+
+    /**
+     * Get the number of times the shared context was woken up
+     */
+    quint64 wakeupCount() const { return m_wakeups; }
+
+    // udev handle shared with the devices
+    struct udev* udev() const { return m_udev; }
+
 signals:
     // Signal emitted when a device is added or removed
     void deviceChanged(bool added, const DeviceInfo& device);
@@ -93,11 +142,20 @@ private:
     // Helper to determine device type 
     bool isDeviceOfType(libinput_device* device, const QString& type);
 
+    // A device in the shared context
+    struct DeviceEntry {
+        QString devnode;
+        DeviceListener* listener;
+        quint64 events;
+    };
+
     // Member variables
     struct udev* m_udev;
     struct libinput* m_libinput;
     QSocketNotifier* m_notifier;
     QVector<std::function<void(bool added, const DeviceInfo&)>> m_callbacks;
+    QMap<libinput_device*, DeviceEntry> m_devices;   // Referenced while in the map
+    quint64 m_wakeups;
 
     // Prohibit copying
     LibinputHelper(const LibinputHelper&) = delete;
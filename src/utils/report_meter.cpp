@@ -0,0 +1,76 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "utils/report_meter.h"
+
+ReportMeter::ReportMeter()
+    : m_reports(0),
+      m_dropped(0),
+      m_duplicates(0),
+      m_lastTimestamp(0)
+{
+}
+
+void ReportMeter::recordReport(int64_t timestamp)
+{
+    m_reports.store(m_reports.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+    if (m_lastTimestamp > 0) {
+        int64_t interval = timestamp - m_lastTimestamp;
+        if (interval <= 0) {
+            m_duplicates.store(m_duplicates.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return;
+        }
+        if (interval <= MaxInterval) {
+            m_intervals.record(interval * 1000);
+        }
+    }
+
+    m_lastTimestamp = timestamp;
+}
+
+void ReportMeter::recordDropped()
+{
+    m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void ReportMeter::reset()
+{
+    m_intervals.reset();
+    m_reports.store(0, std::memory_order_relaxed);
+    m_dropped.store(0, std::memory_order_relaxed);
+    m_duplicates.store(0, std::memory_order_relaxed);
+    m_lastTimestamp = 0;
+}
+
+double ReportMeter::reportRate() const
+{
+    int64_t median = m_intervals.percentile(50.0);
+    if (m_intervals.count() < MinIntervals || median <= 0) {
+        return 0.0;
+    }
+    return 1e9 / median;
+}
+
+double ReportMeter::jitter() const
+{
+    int64_t median = m_intervals.percentile(50.0);
+    if (m_intervals.count() < MinIntervals || median <= 0) {
+        return 0.0;
+    }
+    return static_cast<double>(m_intervals.percentile(99.0)) / median;
+}
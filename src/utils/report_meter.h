@@ -0,0 +1,96 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef REPORT_METER_H
+#define REPORT_METER_H
+
+#include <atomic>
+#include <stdint.h>
+
+#include "utils/latency_histogram.h"
+
+/**
+ * Report rate and timing of one input device
+ *
+ * Fed with the kernel timestamp of every report the device publishes, so
+ * the intervals show how the device and the USB stack deliver reports, not
+ * when the input thread got to read them. The reading thread records; any
+ * thread may read the counters and the histogram.
+ */
+class ReportMeter
+{
+public:
+    // Intervals needed before rate and jitter are reported
+    static const uint64_t MinIntervals = 100;
+
+    // Longer intervals are pauses of the user, not of the device
+    static const int64_t MaxInterval = 100000;     // Microseconds
+
+    ReportMeter();
+
+    /**
+     * Count one report (reading thread only)
+     * @param timestamp Kernel timestamp of the report in microseconds
+     */
+    void recordReport(int64_t timestamp);
+
+    /**
+     * Count reports the kernel dropped, e.g. on SYN_DROPPED (reading thread only)
+     */
+    void recordDropped();
+
+    /**
+     * Clear all counts (reading thread only, or while it is stopped)
+     */
+    void reset();
+
+    uint64_t reports() const { return m_reports.load(std::memory_order_relaxed); }
+
+    // Number of times the kernel reported lost events
+    uint64_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    // Reports stamped no later than the one before
+    uint64_t duplicates() const { return m_duplicates.load(std::memory_order_relaxed); }
+
+    /**
+     * Get the intervals between reports while the device is in use
+     * @return Histogram of intervals in nanoseconds
+     */
+    const LatencyHistogram& intervals() const { return m_intervals; }
+
+    /**
+     * Get the rate the device reports at while it moves, from the median interval
+     * @return Reports per second, 0 until MinIntervals intervals were recorded
+     */
+    double reportRate() const;
+
+    /**
+     * Get how irregular the reports are
+     * @return 99th percentile over median interval, 1.0 for a steady device,
+     *         0 until MinIntervals intervals were recorded
+     */
+    double jitter() const;
+
+private:
+    LatencyHistogram m_intervals;
+    std::atomic<uint64_t> m_reports;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_duplicates;
+    int64_t m_lastTimestamp;        // Reading thread only
+};
+
+#endif // REPORT_METER_H
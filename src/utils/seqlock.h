@@ -0,0 +1,109 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+
+/**
+ * Single-writer sequence lock for small, trivially copyable values
+ *
+ * The writer never blocks. Readers retry only if they overlap with a store,
+ * so neither side ever takes a mutex. The payload is kept in relaxed atomic
+ * words so concurrent reads are well defined.
+ */
+template <typename T>
+class SeqLock
+{
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "SeqLock payload must be trivially copyable");
+
+public:
+    SeqLock()
+        : m_sequence(0)
+    {
+        store(T());
+    }
+
+    /**
+     * Publish a new value. Must only be called from one thread at a time.
+     * @param value Value to publish
+     */
+    void store(const T& value)
+    {
+        uint64_t words[WordCount] = { 0 };
+        memcpy(words, &value, sizeof(T));
+
+        uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        for (size_t i = 0; i < WordCount; i++) {
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+    /**
+     * Read a consistent copy of the last published value
+     * @return Copy of the value
+     */
+    T load() const
+    {
+        uint64_t words[WordCount];
+        uint32_t before;
+        uint32_t after;
+
+        do {
+            before = m_sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WordCount; i++) {
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    /**
+     * Get the number of completed stores, useful for change detection
+     * @return Store count
+     */
+    uint32_t version() const
+    {
+        return m_sequence.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    static const size_t WordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint32_t> m_sequence;
+    std::atomic<uint64_t> m_words[WordCount];
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+};
+
+#endif // SEQLOCK_H
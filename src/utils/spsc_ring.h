@@ -0,0 +1,103 @@
+/*
+**  JoystickFSM - A Qt application for joystick-controlled FSM
+**
+**  This program is free software: you can redistribute it and/or modify
+**  it under the terms of the GNU General Public License as published by
+**  the Free Software Foundation, either version 3 of the License, or
+**  (at your option) any later version.
+**
+**  This program is distributed in the hope that it will be useful,
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+**  GNU General Public License for more details.
+**
+**  You should have received a copy of the GNU General Public License
+**  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <atomic>
+#include <stddef.h>
+#include <type_traits>
+
+/**
+ * Fixed-size single-producer single-consumer ring buffer
+ *
+ * push() and pop() are wait-free and never allocate. When the ring is full
+ * new records are dropped, so a slow consumer can never stall the producer.
+ */
+template<typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing elements must be trivially copyable");
+
+public:
+    SpscRing() : m_head(0), m_tail(0), m_dropped(0) {}
+
+    /**
+     * Append a record (producer thread only)
+     * @return False if the ring was full and the record was dropped
+     */
+    bool push(const T& value)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head - m_tail.load(std::memory_order_acquire) >= Capacity) {
+            m_dropped.store(m_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            return false;
+        }
+
+        m_items[head & (Capacity - 1)] = value;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * Remove up to maxCount of the oldest records (consumer thread only)
+     * @param out Destination for the records
+     * @param maxCount Size of out
+     * @return Number of records copied
+     */
+    size_t pop(T* out, size_t maxCount)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t available = m_head.load(std::memory_order_acquire) - tail;
+        size_t count = available < maxCount ? available : maxCount;
+
+        for (size_t i = 0; i < count; i++) {
+            out[i] = m_items[(tail + i) & (Capacity - 1)];
+        }
+
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * Discard everything in the ring (consumer thread only)
+     */
+    void clear()
+    {
+        m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t size() const
+    {
+        return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_acquire);
+    }
+
+    // Number of records dropped because the ring was full
+    size_t dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    static size_t capacity() { return Capacity; }
+
+private:
+    // Producer and consumer indices on separate cache lines
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+    std::atomic<size_t> m_dropped;
+    T m_items[Capacity];
+};
+
+#endif // SPSC_RING_H
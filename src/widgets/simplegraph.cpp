@@ -122,6 +122,27 @@ void SimpleGraph::AddPoint(int channel, double x, double y)
     }
 }
 
+void SimpleGraph::AddPoints(int channel, const QVector<QPointF>& points)
+{
+    if (channel >= 0 && channel < 16 && !points.isEmpty()) {
+        // Append the whole batch and repaint once
+        m_points[channel] += points;
+
+        // Limit number of points to prevent excessive memory usage
+        int excess = m_points[channel].size() - m_maxPoints;
+        if (excess > 0) {
+            m_points[channel].remove(0, excess);
+        }
+
+        // Update channel count if needed
+        if (channel >= m_channelCount) {
+            m_channelCount = channel + 1;
+        }
+
+        update();
+    }
+}
+
 void SimpleGraph::Chart(const double* data, int channels, int points, double timeInc)
 {
     if (!data || channels <= 0 || points <= 0) {
@@ -44,6 +44,7 @@ public:
     
     // Point tracking for visualization
     void AddPoint(int channel, double x, double y);
+    void AddPoints(int channel, const QVector<QPointF>& points);
     void ClearChannel(int channel);
     
     // Drawing configuration